@@ -0,0 +1,584 @@
+// Micro-benchmarks for the ML and AI hot paths. Run with --benchmark_format=json (or --benchmark_out=<file>) to get
+// results that can be compared against a baseline with Google Benchmark's compare.py. The executable starts the game
+// with a benchmark scene for the scene queries, so it needs the assets next to it like the demo does. --no-scene runs
+// only the ML benchmarks, without starting the game.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Engine.hpp"
+#include "Scene/IGame.hpp"
+#include "Scene/Scene.hpp"
+
+#include "GameML.hpp"
+#include "PlayerInferenceKernel.hpp"
+#include "PlayerInferenceSimd.hpp"
+#include "TopKSelector.hpp"
+#include "SkipVisuals.hpp"
+#include "PlayerEntity.hpp"
+#include "MinionEntity.hpp"
+#include "TeamComponent.hpp"
+#include "SimulationStepEntity.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamRegistryService.hpp"
+#include "FlowFieldService.hpp"
+#include "RespawnService.hpp"
+#include "TowerSystem.hpp"
+#include "MinionSystem.hpp"
+
+static std::minstd_rand g_random(1234);
+
+static float RandomFloat(float min, float max)
+{
+    return std::uniform_real_distribution<float>(min, max)(g_random);
+}
+
+static Vector2 RandomVector(float range)
+{
+    return Vector2(RandomFloat(-range, range), RandomFloat(-range, range));
+}
+
+template<int Capacity>
+static void FillUnits(ObservedUnits<Capacity>& units)
+{
+    units.Clear();
+    int count = std::uniform_int_distribution<int>(0, Capacity)(g_random);
+    for (int i = 0; i < count; ++i)
+    {
+        units.TryAdd(RandomVector(1), RandomVector(1), RandomFloat(0, 1));
+    }
+}
+
+static Observation RandomObservation()
+{
+    Observation observation;
+    FillUnits(observation.players);
+    FillUnits(observation.minions);
+
+    observation.buildings.Clear();
+    for (int i = 0; i < MaxObservedBuildings; ++i)
+    {
+        observation.buildings.TryAdd(RandomVector(1), RandomFloat(0, 1));
+    }
+
+    return observation;
+}
+
+static std::vector<PlayerNetwork::SampleType> RandomSamples(int count)
+{
+    std::vector<PlayerNetwork::SampleType> samples(count);
+    for (auto& sample : samples)
+    {
+        sample.input = RandomObservation();
+        sample.output.actionIndex = std::uniform_int_distribution<int>(0, 2)(g_random);
+        sample.output.moveCoord = Vector2(RandomFloat(0, 1), RandomFloat(0, 1));
+        sample.output.entityChoice = std::uniform_int_distribution<int>(0, 2)(g_random);
+    }
+
+    return samples;
+}
+
+struct ObservationBatch
+{
+    int Rows() const { return static_cast<int>(observations.size()); }
+    int Cols() const { return 1; }
+    const Observation* operator[](int row) const { return &observations[row]; }
+
+    std::vector<Observation> observations;
+};
+
+static ObservationBatch RandomBatch(int batchSize)
+{
+    ObservationBatch batch;
+    for (int i = 0; i < batchSize; ++i)
+    {
+        batch.observations.push_back(RandomObservation());
+    }
+
+    return batch;
+}
+
+// Converting observations to features and packing them into tensors, which replaced the per-entity Convert* helpers
+static void BM_PackObservations(benchmark::State& state)
+{
+    auto batch = RandomBatch(state.range(0));
+    PlayerBatchPacker packer;
+
+    for (auto _ : state)
+    {
+        packer.PackObservations(batch, [](const Observation& observation) -> const Observation& { return observation; });
+        benchmark::DoNotOptimize(packer.players.data_ptr());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PackObservations)->RangeMultiplier(4)->Range(1, 1024);
+
+static void BM_Forward(benchmark::State& state)
+{
+    PlayerNetwork network;
+    auto batch = RandomBatch(state.range(0));
+
+    PlayerBatchPacker packer;
+    packer.PackObservations(batch, [](const Observation& observation) -> const Observation& { return observation; });
+
+    torch::NoGradGuard noGrad;
+    for (auto _ : state)
+    {
+        auto output = network.Forward(packer.players, packer.minions, packer.buildings);
+        benchmark::DoNotOptimize(std::get<0>(output).data_ptr());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Forward)->RangeMultiplier(4)->Range(1, 1024);
+
+// Goes through the same path as MakeDecision, which takes its batch as a Grid
+static void BM_DecideBatch(benchmark::State& state)
+{
+    PlayerNetwork network;
+    auto batch = RandomBatch(state.range(0));
+    std::vector<TrainingLabel> outputs(batch.observations.size());
+
+    for (auto _ : state)
+    {
+        network.DecideBatch(batch.observations, outputs);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DecideBatch)->RangeMultiplier(4)->Range(1, 1024);
+
+// The kernels are only worth timing if they compute what they replace, so each benchmark first checks its kernel
+// against the reference on a fresh batch and fails with the difference when it's out of tolerance
+static constexpr float KernelTolerance = 1e-4f;
+static constexpr float MinQuantizedActionAgreement = 0.9f;
+static constexpr float MaxQuantizedMoveError = 0.02f;
+
+// Largest difference between the kernel's and torch's log-probabilities and move coordinates over the batch
+static float KernelDifferenceFromTorch(PlayerNetwork& network, const PlayerInferenceKernel& kernel, const ObservationBatch& batch)
+{
+    PlayerBatchPacker packer;
+    packer.PackObservations(batch, [](const Observation& observation) -> const Observation& { return observation; });
+
+    torch::NoGradGuard noGrad;
+    auto torchOutput = network.Forward(packer.players, packer.minions, packer.buildings);
+    auto torchAction = std::get<0>(torchOutput).reshape({ batch.Rows(), 3 }).contiguous();
+    auto torchMove = std::get<1>(torchOutput).reshape({ batch.Rows(), 2 }).contiguous();
+    auto torchEntity = std::get<2>(torchOutput).reshape({ batch.Rows(), 3 }).contiguous();
+
+    float maxDifference = 0;
+    for (int i = 0; i < batch.Rows(); ++i)
+    {
+        float action[3];
+        float move[2];
+        float entity[3];
+        kernel.Evaluate(batch.observations[i], action, move, entity);
+
+        auto kernelAction = torch::log_softmax(torch::from_blob(action, { 3 }), 0);
+        auto kernelEntity = torch::log_softmax(torch::from_blob(entity, { 3 }), 0);
+
+        maxDifference = std::max(maxDifference, (kernelAction - torchAction[i]).abs().max().item<float>());
+        maxDifference = std::max(maxDifference, (torch::from_blob(move, { 2 }) - torchMove[i]).abs().max().item<float>());
+        maxDifference = std::max(maxDifference, (kernelEntity - torchEntity[i]).abs().max().item<float>());
+    }
+
+    return maxDifference;
+}
+
+static void BM_KernelDecide(benchmark::State& state)
+{
+    PlayerNetwork network;
+    PlayerInferenceKernel kernel;
+    kernel.Export(*network.model);
+
+    auto batch = RandomBatch(state.range(0));
+    float difference = KernelDifferenceFromTorch(network, kernel, batch);
+    state.counters["max_difference"] = difference;
+    state.SetLabel(GetDenseApplyName());
+
+    if (difference > KernelTolerance)
+    {
+        state.SkipWithError(("kernel differs from torch by " + std::to_string(difference)).c_str());
+        return;
+    }
+
+    TrainingLabel output;
+    for (auto _ : state)
+    {
+        for (auto& observation : batch.observations)
+        {
+            kernel.Decide(observation, output);
+        }
+
+        benchmark::DoNotOptimize(output);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_KernelDecide)->RangeMultiplier(4)->Range(1, 1024);
+
+// Calibrated on one set of observations and checked against the fp32 kernel on another, as it would be in a match
+static void BM_QuantizedDecide(benchmark::State& state)
+{
+    PlayerNetwork network;
+    PlayerInferenceKernel kernel;
+    kernel.Export(*network.model);
+
+    auto calibrationSet = RandomBatch(256).observations;
+    ActivationRanges ranges;
+    CalibratePlayerKernel(kernel, calibrationSet, ranges);
+    auto quantizedKernel = QuantizePlayerKernel(kernel, InferencePrecision::Int8, ranges);
+
+    auto batch = RandomBatch(state.range(0));
+    auto checkSet = RandomBatch(1024).observations;
+
+    int sameAction = 0;
+    float moveError = 0;
+    for (auto& observation : checkSet)
+    {
+        TrainingLabel expected;
+        TrainingLabel actual;
+        kernel.Decide(observation, expected);
+        quantizedKernel->Decide(observation, actual);
+
+        sameAction += expected.actionIndex == actual.actionIndex;
+        moveError += (expected.moveCoord - actual.moveCoord).Length();
+    }
+
+    float actionAgreement = static_cast<float>(sameAction) / checkSet.size();
+    float meanMoveError = moveError / checkSet.size();
+    state.counters["action_agreement"] = actionAgreement;
+    state.counters["mean_move_error"] = meanMoveError;
+
+    if (actionAgreement < MinQuantizedActionAgreement || meanMoveError > MaxQuantizedMoveError)
+    {
+        state.SkipWithError(("int8 kernel agrees with fp32 on " + std::to_string(100 * actionAgreement)
+            + "% of actions, mean move error " + std::to_string(meanMoveError)).c_str());
+        return;
+    }
+
+    TrainingLabel output;
+    for (auto _ : state)
+    {
+        for (auto& observation : batch.observations)
+        {
+            quantizedKernel->Decide(observation, output);
+        }
+
+        benchmark::DoNotOptimize(output);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QuantizedDecide)->RangeMultiplier(4)->Range(1, 1024);
+
+static void BM_TrainBatch(benchmark::State& state)
+{
+    PlayerNetwork network;
+    auto samples = RandomSamples(state.range(0));
+    Grid<const PlayerNetwork::SampleType> grid(state.range(0), 1, samples.data());
+
+    for (auto _ : state)
+    {
+        StrifeML::TrainingBatchResult result;
+        network.TrainBatch(grid, result);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrainBatch)->RangeMultiplier(4)->Range(8, 512);
+
+// Scene queries are measured on a live scene, with the same services as the game and no castles, towers or players
+// of its own. Each benchmark takes the number of minions in the lane as its argument. BenchmarkSceneService lays out a
+// lane of that many idle minions and a few players, lets physics settle for a moment so minion engagement contacts
+// exist, and then lets the benchmark run while the game thread waits.
+static constexpr int BenchmarkPlayerCount = 10;
+static constexpr int SettleUpdates = 30;
+
+static Scene* g_scene = nullptr;
+static std::vector<PlayerEntity*> g_players;
+static std::vector<MinionEntity*> g_minions;
+
+static void UseLane(int minionCount);
+
+// GetObservation's TopKSelector slot picking, over the spatial hash's k-nearest queries
+static void BM_GetObservation(benchmark::State& state)
+{
+    UseLane(state.range(0));
+
+    Observation observation;
+
+    for (auto _ : state)
+    {
+        for (auto player : g_players)
+        {
+            player->GetObservation(observation);
+        }
+
+        benchmark::DoNotOptimize(observation);
+    }
+
+    state.SetItemsProcessed(state.iterations() * g_players.size());
+}
+
+static void BM_FindNearestEnemyMinion(benchmark::State& state)
+{
+    UseLane(state.range(0));
+
+    auto spatialHash = g_scene->GetService<SpatialHashService>();
+
+    for (auto _ : state)
+    {
+        for (auto player : g_players)
+        {
+            auto nearest = spatialHash->FindNearest<MinionEntity>(player->Center(), TeamFilter::EnemiesOf(player->team->teamId));
+            benchmark::DoNotOptimize(nearest);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * g_players.size());
+}
+
+static void BM_FindKNearestMinions(benchmark::State& state)
+{
+    UseLane(state.range(0));
+
+    auto spatialHash = g_scene->GetService<SpatialHashService>();
+
+    for (auto _ : state)
+    {
+        for (auto player : g_players)
+        {
+            TopKSelector<MinionEntity*, MaxObservedMinions> nearest;
+            spatialHash->FindKNearest<MinionEntity>(player->Center(), TeamFilter::Any(), nearest);
+            benchmark::DoNotOptimize(nearest.SortAndBegin());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * g_players.size());
+}
+
+// Minions owned by the MinionSystem get their targets from the spatial hash instead, which the queries above cover
+static void BM_MinionFindTargetOrNull(benchmark::State& state)
+{
+    UseLane(state.range(0));
+
+    for (auto _ : state)
+    {
+        for (auto minion : g_minions)
+        {
+            benchmark::DoNotOptimize(minion->FindTargetOrNull());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * g_minions.size());
+}
+
+static void RegisterSceneBenchmarks()
+{
+    for (auto sceneBenchmark : {
+        benchmark::RegisterBenchmark("BM_GetObservation", BM_GetObservation),
+        benchmark::RegisterBenchmark("BM_FindNearestEnemyMinion", BM_FindNearestEnemyMinion),
+        benchmark::RegisterBenchmark("BM_FindKNearestMinions", BM_FindKNearestMinions),
+        benchmark::RegisterBenchmark("BM_MinionFindTargetOrNull", BM_MinionFindTargetOrNull) })
+    {
+        sceneBenchmark->RangeMultiplier(10)->Range(10, 10000);
+    }
+}
+
+// The benchmarks run on their own thread, and the scene is handed back and forth between it and the game thread so
+// that only one of them uses it at a time. When a benchmark asks for a lane of a different size, the game thread
+// rebuilds it and runs updates until it has settled, then waits inside an update while the benchmark runs.
+struct BenchmarkSceneService : ISceneService
+{
+    void ReceiveEvent(const IEntityEvent& ev) override
+    {
+        if (ev.Is<SceneLoadedEvent>())
+        {
+            scene->CreateEntity<SimulationStepEntity>(Vector2(0, 0));
+            g_scene = scene;
+        }
+        else if (ev.Is<UpdateEvent>())
+        {
+            Update();
+        }
+    }
+
+    void Update()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (finished)
+        {
+            return;
+        }
+        else if (!benchmarkThread.joinable())
+        {
+            benchmarksHoldScene = true;
+            benchmarkThread = std::thread([this] { RunBenchmarks(); });
+        }
+        else if (laneMinionCount == requestedMinionCount && ++updatesSinceRebuild >= SettleUpdates)
+        {
+            benchmarksHoldScene = true;
+            sceneHandedOver.notify_all();
+        }
+        else
+        {
+            return;
+        }
+
+        sceneHandedOver.wait(lock, [this] { return !benchmarksHoldScene; });
+
+        if (finished)
+        {
+            lock.unlock();
+            benchmarkThread.join();
+            scene->GetEngine()->QuitGame();
+            return;
+        }
+
+        RebuildLane(requestedMinionCount);
+        laneMinionCount = requestedMinionCount;
+        updatesSinceRebuild = 0;
+    }
+
+    // Called from a benchmark, which holds the scene. Returns once a settled lane of minionCount minions exists.
+    void UseLane(int minionCount)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (laneMinionCount == minionCount)
+        {
+            return;
+        }
+
+        requestedMinionCount = minionCount;
+        benchmarksHoldScene = false;
+        sceneHandedOver.notify_all();
+        sceneHandedOver.wait(lock, [this] { return benchmarksHoldScene; });
+    }
+
+    void RunBenchmarks()
+    {
+        benchmark::RunSpecifiedBenchmarks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        benchmarksHoldScene = false;
+        sceneHandedOver.notify_all();
+    }
+
+    // A square of minions in columns that alternate teams every few columns, so each one has enemies inside its
+    // engagement radius, with the players spread along its top edge
+    void RebuildLane(int minionCount)
+    {
+        for (auto minion : g_minions) minion->Destroy();
+        for (auto player : g_players) player->Destroy();
+        g_minions.clear();
+        g_players.clear();
+
+        const int rows = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(minionCount))));
+        const float spacing = 32;
+        const Vector2 laneStart(600, 2000);
+
+        for (int i = 0; i < minionCount; ++i)
+        {
+            int column = i / rows;
+            auto minion = scene->CreateEntity<MinionEntity>(laneStart + Vector2(column * spacing, (i % rows) * spacing));
+            minion->team->SetTeam(column / 3 % 2);
+            g_minions.push_back(minion);
+        }
+
+        float laneLength = ((minionCount + rows - 1) / rows) * spacing;
+        for (int i = 0; i < BenchmarkPlayerCount; ++i)
+        {
+            auto player = scene->CreateEntity<PlayerEntity>(laneStart + Vector2(laneLength * i / BenchmarkPlayerCount, -64));
+            player->playerId = i % 2;
+            player->team->SetTeam(i % 2);
+            g_players.push_back(player);
+        }
+    }
+
+    std::thread benchmarkThread;
+    std::mutex mutex;
+    std::condition_variable sceneHandedOver;
+    bool benchmarksHoldScene = false;
+    bool finished = false;
+    int requestedMinionCount = 0;
+    int laneMinionCount = 0;
+    int updatesSinceRebuild = 0;
+};
+
+static void UseLane(int minionCount)
+{
+    g_scene->GetService<BenchmarkSceneService>()->UseLane(minionCount);
+}
+
+struct BenchmarkGame : IGame
+{
+    void ConfigureGame(GameConfig& config) override
+    {
+        config
+            .SetDefaultScene("erebor"_sid)
+            .SetWindowCaption("Strife Singleplayer Benchmarks")
+            .SetGameName("Strife Singleplayer Benchmarks");
+    }
+
+    void LoadResources(ResourceManager* resourceManager)
+    {
+        resourceManager->LoadContentFile("Content.json");
+    }
+
+    void BuildScene(Scene* scene) override
+    {
+        scene->AddService<TeamRegistryService>();
+        scene->AddService<FlowFieldService>();
+        scene->AddService<SpatialHashService>();
+        scene->AddService<RespawnService>();
+        scene->AddService<TowerSystem>();
+        scene->AddService<MinionSystem>();
+        scene->AddService<BenchmarkSceneService>();
+    }
+
+    void OnGameStart() override
+    {
+        GetEngine()->StartSinglePlayerGame("erebor");
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+
+    // Initialize leaves the arguments it doesn't recognize
+    if (argc > 1 && strcmp(argv[1], "--no-scene") == 0)
+    {
+        benchmark::RunSpecifiedBenchmarks();
+        return 0;
+    }
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    RegisterSceneBenchmarks();
+
+    // Entities skip their sprites and lights, which the benchmarks don't need
+    g_skipVisuals = true;
+
+    BenchmarkGame game;
+    game.Run();
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "CastleEntity.hpp"
+#include "Profiler.hpp"
 
 #include "Engine.hpp"
 #include "PlayerEntity.hpp"
@@ -6,6 +7,11 @@
 #include "Components/SpriteComponent.hpp"
 #include "Physics/PathFinding.hpp"
 #include "Net/ReplicationManager.hpp"
+#include "SkipVisuals.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamRegistryService.hpp"
+#include "RespawnService.hpp"
+#include "FlowFieldService.hpp"
 
 void CastleEntity::DoSerialize(EntitySerializer& serializer)
 {
@@ -14,52 +20,49 @@ void CastleEntity::DoSerialize(EntitySerializer& serializer)
 
 void CastleEntity::OnAdded()
 {
-    spriteComponent = AddComponent<SpriteComponent>("castleSprite");
-    spriteComponent->scale = Vector2(5.0f);
+    if (!g_skipVisuals)
+    {
+        spriteComponent = AddComponent<SpriteComponent>("castleSprite");
+        spriteComponent->scale = Vector2(5.0f);
+    }
 
     Vector2 size{ 67 * 5, 55 * 5 };
     SetDimensions(size);
     scene->GetService<PathFinderService>()->AddObstacle(Bounds());
+    scene->GetService<FlowFieldService>()->ObstaclesChanged();
 
     auto rigidBody = AddComponent<RigidBodyComponent>(b2_staticBody);
     rigidBody->CreateBoxCollider(size);
     
     team = AddComponent<TeamComponent>();
+    AddComponent<SpatialIndexComponent>();
 
     auto offset = size / 2 + Vector2(40, 40);
 
     _spawnSlots[0] = Center() + offset.YVector();
     _spawnSlots[1] = Center() - offset.YVector();
 
-    _light = AddComponent<LightComponent<PointLight>>();
-    _light->position = Center();
-    _light->intensity = 0.5;
-    _light->maxDistance = 500;
+    if (!g_skipVisuals)
+    {
+        _light = AddComponent<LightComponent<PointLight>>();
+        _light->position = Center();
+        _light->intensity = 0.5;
+        _light->maxDistance = 500;
+    }
 }
 
-void CastleEntity::Update(float deltaTime)
+void CastleEntity::SpawnPlayer()
 {
-    int teamCount = 0;
-    for (auto player : scene->GetEntitiesOfType<PlayerEntity>())
-    {
-        if (player->team->teamId == team->teamId)
-        {
-            teamCount++;
-        }
-    }
+    PROFILE_ZONE("CastleEntity::SpawnPlayer");
 
-    if (teamCount < 2)
+    // playerId is assigned after the castle is added, so the light is colored here rather than in OnAdded
+    if (_light != nullptr)
     {
-        SpawnPlayer();
+        _light->color = playerId == 0
+            ? Color::Green()
+            : Color::White();
     }
 
-    _light->color = playerId == 0
-        ? Color::Green()
-        : Color::White();
-}
-
-void CastleEntity::SpawnPlayer()
-{
     auto position = _spawnSlots[_nextSpawnSlotId];
     _nextSpawnSlotId = (_nextSpawnSlotId + 1) % 2;
 
@@ -70,21 +73,20 @@ void CastleEntity::SpawnPlayer()
 
     if (player->TryGetComponent(playerTeam))
     {
-        playerTeam->teamId = playerId;
+        playerTeam->SetTeam(playerId);
     }
 }
 
 void CastleEntity::OnDestroyed()
 {
-    for (auto player : scene->GetEntitiesOfType<PlayerEntity>())
+    // Players are always on their playerId's team
+    scene->GetService<TeamRegistryService>()->ForEach<PlayerEntity>(playerId, [](PlayerEntity* player)
     {
-        if (player->playerId == playerId)
-        {
-            player->Destroy();
-        }
-    }
+        player->Destroy();
+    });
 
     scene->GetService<PathFinderService>()->RemoveObstacle(Bounds());
+    scene->GetService<FlowFieldService>()->ObstaclesChanged();
 }
 
 void CastleEntity::ReceiveEvent(const IEntityEvent& ev)
@@ -94,6 +96,11 @@ void CastleEntity::ReceiveEvent(const IEntityEvent& ev)
         Destroy();
     }
 
+    if (ev.Is<PlayerDestroyedEvent>())
+    {
+        scene->GetService<RespawnService>()->QueueRespawn(this);
+    }
+
     if (ev.Is<TowerDestroyedEvent>())
     {
         auto hb = AddComponent<HealthBarComponent>();
@@ -13,7 +13,6 @@ DEFINE_ENTITY(CastleEntity, "castle")
 {
     void OnAdded() override;
     void OnDestroyed() override;
-    void Update(float deltaTime) override;
     void SpawnPlayer();
 
     void ReceiveEvent(const IEntityEvent& ev) override;
@@ -27,10 +26,10 @@ DEFINE_ENTITY(CastleEntity, "castle")
 
 private:
     float _colorChangeTime = 0;
-    SpriteComponent* spriteComponent;
+    SpriteComponent* spriteComponent = nullptr;
 
     Vector2 _spawnSlots[2];
     int _nextSpawnSlotId = 0;
 
-    LightComponent<PointLight>* _light;
+    LightComponent<PointLight>* _light = nullptr;
 };
\ No newline at end of file
@@ -4,10 +4,14 @@
 #include "HealthBarComponent.hpp"
 #include "TeamComponent.hpp"
 #include "Renderer/Renderer.hpp"
+#include "SkipVisuals.hpp"
+#include "Profiler.hpp"
 
 
 void FireballEntity::Render(Renderer* renderer)
 {
+    PROFILE_ZONE("FireballEntity::Render");
+
     renderer->RenderCircle(Center(), Radius, Color::Orange(), -1);
 }
 
@@ -20,14 +24,20 @@ void FireballEntity::OnAdded()
     light.maxDistance = Radius;
     light.intensity = 2;
 
-    scene->GetLightManager()->AddLight(&light);
+    if (!g_skipVisuals)
+    {
+        scene->GetLightManager()->AddLight(&light);
+    }
 
     rb->SetVelocity(velocity);
 }
 
 void FireballEntity::OnDestroyed()
 {
-    scene->GetLightManager()->RemoveLight(&light);
+    if (!g_skipVisuals)
+    {
+        scene->GetLightManager()->RemoveLight(&light);
+    }
 }
 
 void FireballEntity::ReceiveEvent(const IEntityEvent& ev)
@@ -54,7 +64,9 @@ void FireballEntity::ReceiveEvent(const IEntityEvent& ev)
     }
 }
 
-void FireballEntity::Update(float deltaTime)
+void FireballEntity::FixedUpdate(float deltaTime)
 {
+    PROFILE_ZONE("FireballEntity::FixedUpdate");
+
     light.position = Center();
 }
@@ -18,7 +18,7 @@ DEFINE_ENTITY(FireballEntity, "fireball")
     void OnAdded() override;
     void OnDestroyed() override;
     void ReceiveEvent(const IEntityEvent& ev) override;
-    void Update(float deltaTime) override;
+    void FixedUpdate(float deltaTime) override;
 
     PointLight light;
     int ownerId;
@@ -0,0 +1,237 @@
+#include "FlowFieldService.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+#include "Physics/PathFinding.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "Profiler.hpp"
+
+ConsoleVar<bool> g_minionFlowFields("minion-flow-fields", false);
+
+bool FlowFieldService::Enabled()
+{
+    return g_minionFlowFields.Value();
+}
+
+bool FlowFieldService::TryGetDirection(int team, Entity* target, Vector2 position, Vector2& outDirection)
+{
+    if (obstaclesChanged)
+    {
+        UpdateBlockedCells();
+        obstaclesChanged = false;
+
+        for (auto& field : fields)
+        {
+            field->dirty = true;
+        }
+    }
+
+    if (gridWidth == 0 || gridHeight == 0)
+    {
+        return false;
+    }
+
+    FlowField* field = GetOrCreateField(team, target);
+    if (field->dirty)
+    {
+        Build(*field, target);
+        field->dirty = false;
+    }
+
+    auto& isometricSettings = scene->isometricSettings;
+    Vector2 tile = isometricSettings.WorldToTile(position);
+    int cell = TileY(tile) * gridWidth + TileX(tile);
+    if (field->costs[cell] == INFINITY)
+    {
+        return false;
+    }
+
+    // Fields step between tiles, which aren't axis aligned in world space
+    Vector2 direction = field->directions[cell];
+    if (direction == Vector2(0, 0))
+    {
+        outDirection = direction;
+    }
+    else
+    {
+        Vector2 worldStep = isometricSettings.TileToWorld(tile + direction) - isometricSettings.TileToWorld(tile);
+        outDirection = worldStep.Normalize();
+    }
+
+    return true;
+}
+
+int FlowFieldService::TileX(Vector2 tile) const
+{
+    return std::min(std::max(static_cast<int>(std::floor(tile.x)), 0), gridWidth - 1);
+}
+
+int FlowFieldService::TileY(Vector2 tile) const
+{
+    return std::min(std::max(static_cast<int>(std::floor(tile.y)), 0), gridHeight - 1);
+}
+
+FlowFieldService::FlowField* FlowFieldService::GetOrCreateField(int team, Entity* target)
+{
+    FlowField* result = nullptr;
+
+    // Fields whose target is gone won't be asked for again
+    for (int i = static_cast<int>(fields.size()) - 1; i >= 0; --i)
+    {
+        Entity* fieldTarget;
+        if (!fields[i]->target.TryGetValue(fieldTarget))
+        {
+            fields[i] = std::move(fields.back());
+            fields.pop_back();
+        }
+        else if (fieldTarget == target && fields[i]->team == team)
+        {
+            result = fields[i].get();
+        }
+    }
+
+    if (result == nullptr)
+    {
+        fields.push_back(std::make_unique<FlowField>());
+        result = fields.back().get();
+        result->team = team;
+        result->target = EntityReference<Entity>(target);
+    }
+
+    return result;
+}
+
+void FlowFieldService::UpdateBlockedCells()
+{
+    auto pathFinder = scene->GetService<PathFinderService>();
+    gridWidth = pathFinder->Width();
+    gridHeight = pathFinder->Height();
+    blocked.assign(gridWidth * gridHeight, false);
+
+    for (int y = 0; y < gridHeight; ++y)
+    {
+        for (int x = 0; x < gridWidth; ++x)
+        {
+            blocked[y * gridWidth + x] = pathFinder->IsBlocked(x, y);
+        }
+    }
+}
+
+void FlowFieldService::Build(FlowField& field, Entity* target)
+{
+    PROFILE_ZONE("FlowFieldService::Build");
+
+    const int cellCount = gridWidth * gridHeight;
+    const float unreachable = INFINITY;
+
+    std::vector<float>& cost = field.costs;
+    cost.assign(cellCount, unreachable);
+    using QueueEntry = std::pair<float, int>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> open;
+
+    // The target is usually an obstacle itself, so every tile it covers is a goal
+    auto& isometricSettings = scene->isometricSettings;
+    Vector2 topLeft = isometricSettings.WorldToTile(target->Bounds().TopLeft());
+    Vector2 bottomRight = isometricSettings.WorldToTile(target->Bounds().BottomRight());
+    int minX = std::min(TileX(topLeft), TileX(bottomRight));
+    int minY = std::min(TileY(topLeft), TileY(bottomRight));
+    int maxX = std::max(TileX(topLeft), TileX(bottomRight));
+    int maxY = std::max(TileY(topLeft), TileY(bottomRight));
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            cost[y * gridWidth + x] = 0;
+            open.push({ 0.0f, y * gridWidth + x });
+        }
+    }
+
+    const int offsetX[] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+    const int offsetY[] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+    const float stepCost[] = { 1, 1, 1, 1, 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+
+    // Diagonals can't cut the corner of a blocked cell. Both passes use this, so that a cell never points along a
+    // diagonal the search couldn't have taken.
+    auto isCornerCut = [&](int i, int x, int y, int nx, int ny)
+    {
+        return i >= 4 && (blocked[y * gridWidth + nx] || blocked[ny * gridWidth + x]);
+    };
+
+    while (!open.empty())
+    {
+        auto current = open.top();
+        open.pop();
+
+        if (current.first > cost[current.second])
+        {
+            continue;
+        }
+
+        int x = current.second % gridWidth;
+        int y = current.second / gridWidth;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            int nx = x + offsetX[i];
+            int ny = y + offsetY[i];
+            if (nx < 0 || ny < 0 || nx >= gridWidth || ny >= gridHeight)
+            {
+                continue;
+            }
+
+            int neighbor = ny * gridWidth + nx;
+            if (blocked[neighbor] || isCornerCut(i, x, y, nx, ny))
+            {
+                continue;
+            }
+
+            float neighborCost = current.first + stepCost[i];
+            if (neighborCost < cost[neighbor])
+            {
+                cost[neighbor] = neighborCost;
+                open.push({ neighborCost, neighbor });
+            }
+        }
+    }
+
+    // Each cell points at its cheapest neighbor
+    field.directions.assign(cellCount, Vector2(0, 0));
+
+    for (int y = 0; y < gridHeight; ++y)
+    {
+        for (int x = 0; x < gridWidth; ++x)
+        {
+            int cell = y * gridWidth + x;
+            if (cost[cell] == 0 || cost[cell] == unreachable)
+            {
+                continue;
+            }
+
+            float bestCost = cost[cell];
+            Vector2 bestDirection(0, 0);
+
+            for (int i = 0; i < 8; ++i)
+            {
+                int nx = x + offsetX[i];
+                int ny = y + offsetY[i];
+                if (nx < 0 || ny < 0 || nx >= gridWidth || ny >= gridHeight || isCornerCut(i, x, y, nx, ny))
+                {
+                    continue;
+                }
+
+                float neighborCost = cost[ny * gridWidth + nx];
+                if (neighborCost < bestCost)
+                {
+                    bestCost = neighborCost;
+                    bestDirection = Vector2(static_cast<float>(offsetX[i]), static_cast<float>(offsetY[i])).Normalize();
+                }
+            }
+
+            field.directions[cell] = bestDirection;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Scene/Scene.hpp"
+
+// Shared navigation fields for minions walking to an opponent building. Each (team, target) pair gets one field over
+// the PathFinderService's tile grid, holding the direction to walk from every tile, so the path search is paid once per
+// field rather than once per minion. Walkability is read from that grid, which holds the tilemap's walls as well as
+// every obstacle. Fields are rebuilt lazily after an obstacle changes, and dropped once their target is destroyed.
+// Opt-in with minion-flow-fields.
+class FlowFieldService : public ISceneService
+{
+public:
+    static bool Enabled();
+
+    // Call after adding or removing an obstacle from the PathFinderService
+    void ObstaclesChanged() { obstaclesChanged = true; }
+
+    // Unit direction, in world space, to walk from position towards the target, zero once there. Positions off the map
+    // are treated as the nearest tile on it. Returns false if the target can't be reached from position, such as from
+    // inside an obstacle.
+    bool TryGetDirection(int team, Entity* target, Vector2 position, Vector2& outDirection);
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+private:
+    struct FlowField
+    {
+        int team;
+        EntityReference<Entity> target;
+        bool dirty = true;
+        std::vector<Vector2> directions;
+        std::vector<float> costs;
+    };
+
+    int TileX(Vector2 tile) const;
+    int TileY(Vector2 tile) const;
+    FlowField* GetOrCreateField(int team, Entity* target);
+    void UpdateBlockedCells();
+    void Build(FlowField& field, Entity* target);
+
+    std::vector<std::unique_ptr<FlowField>> fields;
+    std::vector<bool> blocked;
+    bool obstaclesChanged = true;
+
+    // Copied from the PathFinderService whenever the blocked tiles are
+    int gridWidth = 0;
+    int gridHeight = 0;
+};
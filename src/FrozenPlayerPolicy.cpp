@@ -0,0 +1,79 @@
+#include "FrozenPlayerPolicy.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// Mirrors PlayerModelImpl::Forward. Parameters are registered as <layer>_weight and <layer>_bias.
+static const char* PlayerPolicyScript = R"JIT(
+def embed(self, x: Tensor, w1: Tensor, b1: Tensor, w2: Tensor, b2: Tensor, w3: Tensor, b3: Tensor) -> Tensor:
+    x = torch.relu(torch.linear(x, w1, b1))
+    x = torch.relu(torch.linear(x, w2, b2))
+    x = torch.linear(x, w3, b3)
+    return torch.sum(x, 2).squeeze()
+
+def head(self, x: Tensor, w1: Tensor, b1: Tensor, w2: Tensor, b2: Tensor, w3: Tensor, b3: Tensor) -> Tensor:
+    x = torch.relu(torch.linear(x, w1, b1))
+    x = torch.relu(torch.linear(x, w2, b2))
+    return torch.linear(x, w3, b3)
+
+def forward(self, players: Tensor, minions: Tensor, buildings: Tensor) -> Tuple[Tensor, Tensor, Tensor]:
+    p = self.embed(players, self.playerEmbed1_weight, self.playerEmbed1_bias, self.playerEmbed2_weight, self.playerEmbed2_bias, self.playerEmbed3_weight, self.playerEmbed3_bias)
+    m = self.embed(minions, self.minionEmbed1_weight, self.minionEmbed1_bias, self.minionEmbed2_weight, self.minionEmbed2_bias, self.minionEmbed3_weight, self.minionEmbed3_bias)
+    b = self.embed(buildings, self.buildingEmbed1_weight, self.buildingEmbed1_bias, self.buildingEmbed2_weight, self.buildingEmbed2_bias, self.buildingEmbed3_weight, self.buildingEmbed3_bias)
+    postRep = torch.cat([p, m, b], 1)
+
+    action = self.head(postRep, self.action1_weight, self.action1_bias, self.action2_weight, self.action2_bias, self.action3_weight, self.action3_bias)
+    move = self.head(postRep, self.move1_weight, self.move1_bias, self.move2_weight, self.move2_bias, self.move3_weight, self.move3_bias)
+    entity = self.head(postRep, self.entity1_weight, self.entity1_bias, self.entity2_weight, self.entity2_bias, self.entity3_weight, self.entity3_bias)
+
+    return torch.log_softmax(action, 1).squeeze(), torch.sigmoid(move).squeeze(), torch.log_softmax(entity, 1).squeeze()
+)JIT";
+
+torch::jit::Module FreezePlayerModel(PlayerModelImpl& model)
+{
+    torch::NoGradGuard noGrad;
+    torch::jit::Module policy("PlayerPolicy");
+
+    for (auto& parameter : model.named_parameters())
+    {
+        auto name = parameter.key();
+        std::replace(name.begin(), name.end(), '.', '_');
+        policy.register_parameter(name, parameter.value().detach().to(torch::kCPU).clone(), false);
+    }
+
+    policy.define(PlayerPolicyScript);
+    policy.eval();
+
+    return torch::jit::freeze(policy);
+}
+
+void ExportFrozenPlayerPolicy(PlayerModelImpl& model, const std::string& path)
+{
+    FreezePlayerModel(model).save(path);
+}
+
+std::shared_ptr<torch::jit::Module> LoadFrozenPlayerPolicy(const std::string& path)
+{
+    try
+    {
+        auto policy = std::make_shared<torch::jit::Module>(torch::jit::load(path, torch::kCPU));
+        policy->eval();
+
+        return policy;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Failed to load frozen policy " << path << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> RunFrozenPlayerPolicy(
+    torch::jit::Module& policy,
+    const torch::Tensor& playerInput,
+    const torch::Tensor& minionInput,
+    const torch::Tensor& buildingInput)
+{
+    auto outputs = policy.forward({ playerInput, minionInput, buildingInput }).toTuple()->elements();
+    return std::make_tuple(outputs[0].toTensor(), outputs[1].toTensor(), outputs[2].toTensor());
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <torch/script.h>
+
+#include "GameML.hpp"
+
+// Builds a TorchScript module computing the same function as the model, with the weights frozen into the graph as
+// constants. The result carries no autograd state and has been through TorchScript's frozen graph optimizations.
+torch::jit::Module FreezePlayerModel(PlayerModelImpl& model);
+
+void ExportFrozenPlayerPolicy(PlayerModelImpl& model, const std::string& path);
+std::shared_ptr<torch::jit::Module> LoadFrozenPlayerPolicy(const std::string& path);
+
+// Same outputs as PlayerModelImpl::Forward
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> RunFrozenPlayerPolicy(
+    torch::jit::Module& policy,
+    const torch::Tensor& playerInput,
+    const torch::Tensor& minionInput,
+    const torch::Tensor& buildingInput);
@@ -4,40 +4,200 @@
 #include <torch/torch.h>
 #include "ML/GridSensor.hpp"
 #include "GameML.hpp"
+#include "PlayerInferenceKernel.hpp"
+#include "FrozenPlayerPolicy.hpp"
+#include "PlayerSampleStore.hpp"
+#include "PlayerBatchPrefetcher.hpp"
+#include "SimulationRecording.hpp"
+#include "GameMetrics.hpp"
+#include "Profiler.hpp"
 #include "Sample.hpp"
 
+#include "Tools/Console.hpp"
+#include "Tools/ConsoleVar.hpp"
 #include "Tools/MetricsManager.hpp"
 
-void PlayerObservation::Serialize(StrifeML::ObjectSerializer& serializer)
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+ConsoleVar<int> g_lossReadInterval("nn-loss-read-interval", 16);
+// Reads every batch's loss back so that the batch printed is the one over the threshold, which stalls on the device
+ConsoleVar<bool> g_dumpHighLossBatches("nn-dump-high-loss", false);
+ConsoleVar<int> g_publishInterval("nn-publish-interval", 10);
+ConsoleVar<bool> g_fastInference("nn-fast-inference", true);
+ConsoleVar<bool> g_validateFastInference("nn-validate-fast-inference", false);
+ConsoleVar<std::string> g_inferencePrecision("nn-precision", "fp32");
+ConsoleVar<int> g_quantizationReportInterval("nn-quantization-report-interval", 100);
+ConsoleVar<std::string> g_frozenPolicyPath("nn-frozen-policy", "");
+ConsoleVar<std::string> g_sampleStorePath("nn-sample-store", "");
+ConsoleVar<float> g_sampleStoreFraction("nn-sample-store-fraction", 0.5f);
+
+// Relative share of each action in training batches
+ConsoleVar<float> g_noneActionWeight("nn-sample-weight-none", 1.0f);
+ConsoleVar<float> g_movingActionWeight("nn-sample-weight-moving", 1.0f);
+ConsoleVar<float> g_attackingActionWeight("nn-sample-weight-attacking", 1.0f);
+
+ConsoleVar<int> g_prefetchLoaders("nn-prefetch-loaders", 1);
+ConsoleVar<int> g_prefetchDepth("nn-prefetch-depth", 4);
+
+static constexpr int TrainingBatchSize = 32;
+static constexpr int SamplesPerActionReservoir = 4096;
+
+// The trainer keeps this many of the latest samples in memory, batches and sequences are both drawn from them
+static constexpr int RecentSampleWindow = 10000;
+
+static constexpr int CalibrationSetSize = 1024;
+static constexpr int MinCalibrationSamples = 256;
+
+// Calibration runs the float kernel over the whole calibration set, so it's only redone every this many published
+// versions. The versions in between quantize their weights with the last ranges.
+ConsoleVar<int> g_calibrationInterval("nn-calibration-interval", 50);
+
+ConsoleVar<std::string> g_checkpointPath("nn-checkpoint-path", "");
+ConsoleVar<int> g_checkpointInterval("nn-checkpoint-interval", 100);
+
+// The most recent checkpoint loaded through nn-load-policy. Networks compare the generation against the last one they
+// adopted, so picking up a new checkpoint costs deciders a single atomic load.
+static std::mutex g_checkpointMutex;
+static PlayerModel g_loadedCheckpoint{ nullptr };
+static std::atomic<uint64_t> g_checkpointGeneration { 0 };
+
+// Declared after the checkpoint it writes, so that a load still running at exit is waited on before that is destroyed
+static std::future<void> g_checkpointLoad;
+
+void LoadPolicyCmd(ConsoleCommandBinder& binder)
 {
-    serializer
-        .Add(position, "position")
-        .Add(velocity, "velocity")
-        .Add(health, "health");
+    std::string path;
+    binder
+        .Bind(path, "path")
+        .Help("Hot-load the player policy from a checkpoint");
+
+    if (g_checkpointLoad.valid() && g_checkpointLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        std::cout << "Still loading the last checkpoint, not loading " << path << std::endl;
+        return;
+    }
+
+    // Load off the game thread, the networks swap it in on their next decision
+    g_checkpointLoad = std::async(std::launch::async, [=]
+    {
+        try
+        {
+            PlayerModel checkpoint;
+            torch::load(checkpoint, path);
+            checkpoint->eval();
+
+            std::lock_guard<std::mutex> guard(g_checkpointMutex);
+            g_loadedCheckpoint = checkpoint;
+            g_checkpointGeneration.fetch_add(1, std::memory_order_release);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Failed to load " << path << ": " << e.what() << std::endl;
+        }
+    });
 }
 
+ConsoleCmd g_loadPolicyCmd("nn-load-policy", LoadPolicyCmd);
+
+// Intra-op threads used when training on the CPU, 0 picks a count suited to the network size. Torch has one intra-op
+// pool per process, so this also caps the torch forward passes used for decisions (the fast inference kernel doesn't
+// use the pool). It's applied when training moves to the CPU and stays in effect after moving back to CUDA.
+ConsoleVar<int> g_cpuTrainingThreads("nn-cpu-threads", 0);
+
+static std::atomic<torch::DeviceType> g_requestedTrainingDevice { torch::kCUDA };
 
-void MinionObservation::Serialize(StrifeML::ObjectSerializer& serializer)
+void TrainingDeviceCmd(ConsoleCommandBinder& binder)
 {
-    serializer
-        .Add(position, "position")
-        .Add(velocity, "velocity")
-        .Add(health, "health");
+    std::string deviceName;
+    binder
+        .Bind(deviceName, "device")
+        .Help("Train the player network on 'cuda' or 'cpu'");
+
+    if (deviceName == "cpu")
+    {
+        g_requestedTrainingDevice = torch::kCPU;
+    }
+    else if (deviceName == "cuda")
+    {
+        g_requestedTrainingDevice = torch::kCUDA;
+    }
+    else
+    {
+        std::cout << "Unknown device " << deviceName << ", expected cuda or cpu" << std::endl;
+    }
 }
 
-void BuildingObservation::Serialize(StrifeML::ObjectSerializer& serializer)
+// A command rather than a var so that a switch can be picked up atomically by the training thread. TrainBatch compares
+// against it every batch, so it takes effect whether it's typed in the console or run from user.cfg before or after the
+// network is created.
+ConsoleCmd g_trainingDeviceCmd("nn-device", TrainingDeviceCmd);
+
+static torch::Device ResolveTrainingDevice(torch::DeviceType requested)
 {
-    serializer
-        .Add(position, "position")
-        .Add(health, "health");
+    if (requested == torch::kCUDA && !torch::cuda::is_available())
+    {
+        std::cout << "CUDA is not available, training the player network on the CPU" << std::endl;
+        return torch::Device(torch::kCPU);
+    }
+
+    return torch::Device(requested);
+}
+
+static void ConfigureCpuBackend()
+{
+    // The largest GEMM in a step is (32 * 20) x 72 x 72, which stops scaling after a handful of threads. Spreading it
+    // across every core only adds synchronization and takes cores away from the simulation.
+    int threads = g_cpuTrainingThreads.Value();
+    if (threads <= 0)
+    {
+        threads = std::min(4, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    }
+
+    // Process-wide, see nn-cpu-threads
+    torch::set_num_threads(threads);
+
+    std::cout << "CPU training: " << threads << " intra-op threads (shared with torch inference)" << std::endl;
+}
+
+template<int Capacity>
+static void SerializeUnits(StrifeML::ObjectSerializer& serializer, ObservedUnits<Capacity>& units, const char* countName)
+{
+    serializer.Add(units.count, countName);
+    units.count = std::min(std::max(units.count, 0), Capacity);
+
+    for (int i = 0; i < units.count; ++i)
+    {
+        serializer
+            .Add(units.position[i], "position")
+            .Add(units.velocity[i], "velocity")
+            .Add(units.health[i], "health");
+    }
+}
+
+template<int Capacity>
+static void SerializeBuildings(StrifeML::ObjectSerializer& serializer, ObservedBuildings<Capacity>& buildings, const char* countName)
+{
+    serializer.Add(buildings.count, countName);
+    buildings.count = std::min(std::max(buildings.count, 0), Capacity);
+
+    for (int i = 0; i < buildings.count; ++i)
+    {
+        serializer
+            .Add(buildings.position[i], "position")
+            .Add(buildings.health[i], "health");
+    }
 }
 
 void Observation::Serialize(StrifeML::ObjectSerializer& serializer)
 {
-    serializer
-        .Add(players, "players")
-        .Add(minions, "minions")
-        .Add(buildings, "buildings");
+    SerializeUnits(serializer, players, "players");
+    SerializeUnits(serializer, minions, "minions");
+    SerializeBuildings(serializer, buildings, "buildings");
 }
 
 void TrainingLabel::Serialize(StrifeML::ObjectSerializer& serializer)
@@ -48,133 +208,180 @@ void TrainingLabel::Serialize(StrifeML::ObjectSerializer& serializer)
         .Add(entityChoice, "entity");
 }
 
-PlayerNetwork::PlayerNetwork()
-    : NeuralNetwork<Observation, TrainingLabel>(1)
+PlayerModelImpl::PlayerModelImpl()
 {
-    playerEmbed1 = module->register_module("playerEmbed1", torch::nn::Linear(5, 6));
-    playerEmbed2 = module->register_module("playerEmbed2", torch::nn::Linear(6, 12));
-    playerEmbed3 = module->register_module("playerEmbed3", torch::nn::Linear(12, 24));
+    reset();
+}
 
-    minionEmbed1 = module->register_module("minionEmbed1", torch::nn::Linear(5, 6));
-    minionEmbed2 = module->register_module("minionEmbed2", torch::nn::Linear(6, 12));
-    minionEmbed3 = module->register_module("minionEmbed3", torch::nn::Linear(12, 24));
+void PlayerModelImpl::reset()
+{
+    playerEmbed1 = register_module("playerEmbed1", torch::nn::Linear(5, 6));
+    playerEmbed2 = register_module("playerEmbed2", torch::nn::Linear(6, 12));
+    playerEmbed3 = register_module("playerEmbed3", torch::nn::Linear(12, 24));
 
-    buildingEmbed1 = module->register_module("buildingEmbed1", torch::nn::Linear(3, 6));
-    buildingEmbed2 = module->register_module("buildingEmbed2", torch::nn::Linear(6, 12));
-    buildingEmbed3 = module->register_module("buildingEmbed3", torch::nn::Linear(12, 24));
+    minionEmbed1 = register_module("minionEmbed1", torch::nn::Linear(5, 6));
+    minionEmbed2 = register_module("minionEmbed2", torch::nn::Linear(6, 12));
+    minionEmbed3 = register_module("minionEmbed3", torch::nn::Linear(12, 24));
 
-    action1 = module->register_module("action1", torch::nn::Linear(72, 72));
-    action2 = module->register_module("action2", torch::nn::Linear(72, 72));
-    action3 = module->register_module("action3", torch::nn::Linear(72, 3));
+    buildingEmbed1 = register_module("buildingEmbed1", torch::nn::Linear(3, 6));
+    buildingEmbed2 = register_module("buildingEmbed2", torch::nn::Linear(6, 12));
+    buildingEmbed3 = register_module("buildingEmbed3", torch::nn::Linear(12, 24));
 
-    move1 = module->register_module("move1", torch::nn::Linear(72, 72));
-    move2 = module->register_module("move2", torch::nn::Linear(72, 72));
-    move3 = module->register_module("move3", torch::nn::Linear(72, 2));
+    action1 = register_module("action1", torch::nn::Linear(72, 72));
+    action2 = register_module("action2", torch::nn::Linear(72, 72));
+    action3 = register_module("action3", torch::nn::Linear(72, 3));
 
-    entity1 = module->register_module("entity1", torch::nn::Linear(72, 72));
-    entity2 = module->register_module("entity2", torch::nn::Linear(72, 72));
-    entity3 = module->register_module("entity3", torch::nn::Linear(72, 3));
+    move1 = register_module("move1", torch::nn::Linear(72, 72));
+    move2 = register_module("move2", torch::nn::Linear(72, 72));
+    move3 = register_module("move3", torch::nn::Linear(72, 2));
 
-    optimizer = std::make_shared<torch::optim::Adam>(module->parameters(), 1e-3);
-    module->to(device);
+    entity1 = register_module("entity1", torch::nn::Linear(72, 72));
+    entity2 = register_module("entity2", torch::nn::Linear(72, 72));
+    entity3 = register_module("entity3", torch::nn::Linear(72, 3));
 }
 
-FixedSizeGrid<float, 4, 5> ConvertPlayer(const Observation sample)
+static InferencePrecision ParseInferencePrecision(const std::string& name)
 {
-    FixedSizeGrid<float, 4, 5> grid;
+    if (name == "int8") return InferencePrecision::Int8;
+    if (name == "int8-int16") return InferencePrecision::Int8Int16;
+    if (name != "fp32") std::cout << "Unknown inference precision " << name << ", using fp32" << std::endl;
 
-    for (int i = 0; i < sample.players.size(); i++)
-    {
-        grid[i][0] = sample.players[i].position.x;
-        grid[i][1] = sample.players[i].position.y;
-        grid[i][2] = sample.players[i].velocity.x;
-        grid[i][3] = sample.players[i].velocity.y;
-        grid[i][4] = sample.players[i].health;
-    }
+    return InferencePrecision::Float32;
+}
 
-	for (int i = sample.players.size(); i < 4; i++)
+PlayerNetwork::PlayerNetwork()
+    : NeuralNetwork<Observation, TrainingLabel>(1)
+{
+    // Seeded runs start from the same initial weights
+    if (uint32_t seed = GetSimulationSeed())
     {
-        grid[i][0] = 0;
-        grid[i][1] = 0;
-        grid[i][2] = 0;
-        grid[i][3] = 0;
-        grid[i][4] = 0;
+        torch::manual_seed(seed);
+        calibrationRandom.seed(seed);
     }
 
-    return grid;
-}
+    model = module->register_module("model", PlayerModel());
+    precision = ParseInferencePrecision(g_inferencePrecision.Value());
 
-FixedSizeGrid<float, 12, 5> ConvertMinion(const Observation sample)
-{
-    FixedSizeGrid<float, 12, 5> grid;
+#ifdef SINGLEPLAYER_DECIDER_ONLY
+    // Nothing is trained, so there's no device to probe and no optimizer to build
+    device = torch::Device(torch::kCPU);
 
-    for (int i = 0; i < sample.minions.size(); i++)
+    if (!g_frozenPolicyPath.Value().empty())
     {
-        grid[i][0] = sample.minions[i].position.x;
-        grid[i][1] = sample.minions[i].position.y;
-        grid[i][2] = sample.minions[i].velocity.x;
-        grid[i][3] = sample.minions[i].velocity.y;
-        grid[i][4] = sample.minions[i].health;
+        frozenPolicy = LoadFrozenPlayerPolicy(g_frozenPolicyPath.Value());
     }
 
-    for (int i = sample.minions.size(); i < 12; i++)
+    // Without a policy every decision would come from untrained weights
+    if (frozenPolicy == nullptr)
     {
-        grid[i][0] = 0;
-        grid[i][1] = 0;
-        grid[i][2] = 0;
-        grid[i][3] = 0;
-        grid[i][4] = 0;
+        throw std::runtime_error("Decider-only builds need nn-frozen-policy set to an exported policy");
+    }
+#else
+    requestedDeviceType = g_requestedTrainingDevice.load();
+    device = ResolveTrainingDevice(requestedDeviceType);
+    if (device.is_cpu())
+    {
+        ConfigureCpuBackend();
     }
 
-    return grid;
+    module->to(device);
+#endif
+
+    PublishInferenceWeights();
 }
 
-FixedSizeGrid<float, 4, 3> ConvertBuilding(const Observation sample)
+torch::Tensor PlayerBatchPacker::Stage(torch::Tensor& staging, torch::IntArrayRef shape, torch::ScalarType type)
 {
-    FixedSizeGrid<float, 4, 3> grid;
-
-    for (int i = 0; i < sample.buildings.size(); i++)
+    int64_t elementCount = 1;
+    for (auto dimension : shape)
     {
-        grid[i][0] = sample.buildings[i].position.x;
-        grid[i][1] = sample.buildings[i].position.y;
-        grid[i][2] = sample.buildings[i].health;
+        elementCount *= dimension;
     }
 
-    // todo there should be a faster way to fill the grid with 0s
-	for (int i = sample.buildings.size(); i < 4; i++)
+    if (pinMemory)
     {
-        grid[i][0] = 0;
-        grid[i][1] = 0;
-        grid[i][2] = 0;
+        staging = torch::empty({ elementCount }, torch::TensorOptions().dtype(type).pinned_memory(true));
+    }
+    else if (!staging.defined() || staging.scalar_type() != type || staging.numel() < elementCount)
+    {
+        staging = torch::empty({ elementCount }, torch::TensorOptions().dtype(type));
     }
 
-    return grid;
+    return staging.narrow(0, 0, elementCount).view(shape);
 }
 
-FixedSizeGrid<float, 1, 2> ConvertMove(const Vector2 coord)
+void PlayerNetwork::TrainBatch(Grid<const SampleType> input, StrifeML::TrainingBatchResult& outResult)
 {
-    FixedSizeGrid<float, 1, 2> grid;
+    PROFILE_ZONE("PlayerNetwork::TrainBatch");
 
-    grid[0][0] = coord.x;
-    grid[0][1] = coord.y;
+    //Log("Train batch start\n");
+    auto requested = g_requestedTrainingDevice.load(std::memory_order_relaxed);
+    if (requested != requestedDeviceType)
+    {
+        requestedDeviceType = requested;
+        MoveToDevice(ResolveTrainingDevice(requested));
+    }
 
-    return grid;
-}
+    if (trainingWeightsStale.load())
+    {
+        // A checkpoint was hot-loaded, continue training from it. Held against publishing so that the replica copied
+        // from is the checkpoint's.
+        std::lock_guard<std::mutex> guard(publishMutex);
+        trainingWeightsStale = false;
+
+        torch::NoGradGuard noGrad;
+        auto replica = std::atomic_load(&inferenceReplica);
+        auto source = replica->model->parameters();
+        auto destination = model->parameters();
+
+        for (size_t i = 0; i < destination.size(); ++i)
+        {
+            destination[i].copy_(source[i]);
+        }
+    }
+
+    if (optimizer == nullptr)
+    {
+        optimizer = std::make_shared<torch::optim::Adam>(module->parameters(), 1e-3);
+    }
 
-void PlayerNetwork::TrainBatch(Grid<const SampleType> input, StrifeML::TrainingBatchResult& outResult)
-{
-    //Log("Train batch start\n");
     optimizer->zero_grad();
 
-    //Log("Pack spatial\n");
-    torch::Tensor playerInput = PackIntoTensor(input, [=](auto& sample) { return ConvertPlayer(sample.input); }).to(device);
-    torch::Tensor minionInput = PackIntoTensor(input, [=](auto& sample) { return ConvertMinion(sample.input); }).to(device);
-    torch::Tensor buildingInput = PackIntoTensor(input, [=](auto& sample) { return ConvertBuilding(sample.input); }).to(device);
+    torch::Tensor playerInput, minionInput, buildingInput;
+    torch::Tensor actionLabel, moveLabel, entityLabel;
+
+    // Train on the batch the loaders prepared if the trainer took one, otherwise pack the one we were given
+    auto prepared = std::move(preparedBatch);
+    if (prepared != nullptr)
+    {
+        // Only if the device changed since the trainer took it
+        bool moved = prepared->device != device;
 
-    //Log("Pack labels\n");
-    torch::Tensor actionLabel = PackIntoTensor(input, [=](auto& sample) { return static_cast<int64_t>(sample.output.actionIndex); }).to(device).squeeze();
-    torch::Tensor moveLabel = PackIntoTensor(input, [=](auto& sample) { return ConvertMove(sample.output.moveCoord); }).to(device).squeeze();
-    torch::Tensor entityLabel = PackIntoTensor(input, [=](auto& sample) { return static_cast<int64_t>(sample.output.entityChoice); }).to(device).squeeze();
+        playerInput = moved ? prepared->players.to(device) : prepared->players;
+        minionInput = moved ? prepared->minions.to(device) : prepared->minions;
+        buildingInput = moved ? prepared->buildings.to(device) : prepared->buildings;
+
+        actionLabel = moved ? prepared->actionLabels.to(device) : prepared->actionLabels;
+        moveLabel = moved ? prepared->moveLabels.to(device) : prepared->moveLabels;
+        entityLabel = moved ? prepared->entityLabels.to(device) : prepared->entityLabels;
+    }
+    else
+    {
+        //Log("Pack batch\n");
+        trainingPacker.SetPinMemory(device.is_cuda());
+        trainingPacker.PackObservations(input, [](const SampleType& sample) -> const Observation& { return sample.input; });
+        trainingPacker.PackLabels(input);
+
+        // Copies out of pinned memory are asynchronous, the host doesn't wait for them
+        bool nonBlocking = device.is_cuda();
+        playerInput = trainingPacker.players.to(device, nonBlocking);
+        minionInput = trainingPacker.minions.to(device, nonBlocking);
+        buildingInput = trainingPacker.buildings.to(device, nonBlocking);
+
+        actionLabel = trainingPacker.actionLabels.to(device, nonBlocking).squeeze();
+        moveLabel = trainingPacker.moveLabels.to(device, nonBlocking).squeeze();
+        entityLabel = trainingPacker.entityLabels.to(device, nonBlocking).squeeze();
+    }
 
     //Log("Predicting...\n");
     auto prediction = Forward(playerInput, minionInput, buildingInput);
@@ -202,43 +409,23 @@ void PlayerNetwork::TrainBatch(Grid<const SampleType> input, StrifeML::TrainingB
     torch::Tensor moveLoss = torch::nn::functional::mse_loss(movePrediction, moveLabel, torch::nn::MSELossOptions(torch::kNone));
     torch::Tensor entityLoss = torch::nn::functional::nll_loss(entityPrediction, entityLabel, torch::nn::NLLLossOptions().reduction(torch::kNone));
 
-    for (int i = 0; i < actionLabel.size(0); i++)
-    {
-        auto actionId = actionLabel.index({ i }).item<int64_t>();
-
-        //std::cout << actionId << std::endl; 
+    // Only moving samples train the move head and only attacking samples train the entity head. The masks are built
+    // on the device so that no per-sample label has to be read back to the host.
+    torch::Tensor moveMask = actionLabel.eq(static_cast<int64_t>(1)).to(moveLoss.scalar_type()).unsqueeze(1);
+    torch::Tensor entityMask = actionLabel.eq(static_cast<int64_t>(2)).to(entityLoss.scalar_type());
 
-        try
-        {
-            if (actionId != 1)
-            {
-                moveLoss[i] *= 0;
-            }
+    moveLoss = mean(moveLoss * moveMask);
+    entityLoss = mean(entityLoss * entityMask);
 
-            if (actionId != 2)
-            {
-                entityLoss[i] *= 0;
-            }
-        }
-        catch (const std::exception& e)
-        {
-            std::cout << e.what() << std::endl;
-            throw;
-        }
-    }
-
-    //std::cout << "losses: " << std::endl << moveLoss << std::endl;
-    //std::cout << entityLoss << std::endl;
-
-    moveLoss = mean(moveLoss);
-    entityLoss = mean(entityLoss);
+    torch::Tensor loss = choiceLoss + moveLoss + entityLoss;
 
-    //std::cout << moveLoss << std::endl;
-    //std::cout << entityLoss << std::endl;
+    //Log("Call backward\n");
+    loss.backward();
 
-    torch::Tensor loss = choiceLoss + moveLoss + entityLoss;
+    //Log("Call optimizer step\n");
+    optimizer->step();
 
-    if (loss.item<float>() > 10.0f)
+    outResult.loss = ReadLossIfDue(loss.detach(), [&]
     {
         std::cout << "move: " << std::endl << movePrediction << std::endl;
         std::cout << moveLabel << std::endl;
@@ -246,30 +433,159 @@ void PlayerNetwork::TrainBatch(Grid<const SampleType> input, StrifeML::TrainingB
         std::cout << entityLabel << std::endl;
         std::cout << "losses: " << std::endl << moveLoss << std::endl;
         std::cout << entityLoss << std::endl;
+    });
+
+    g_gameMetrics.batchesTrained.Add();
+
+    if (++trainStepsSincePublish >= std::max(1, g_publishInterval.Value()))
+    {
+        trainStepsSincePublish = 0;
+        PublishInferenceWeights();
     }
 
-    //Log("Call backward\n");
-    loss.backward();
+    //Log("Train batch end\n");
+}
 
-    //Log("Call optimizer step\n");
-    optimizer->step();
+template<typename TDumpBatch>
+float PlayerNetwork::ReadLossIfDue(const torch::Tensor& batchLoss, TDumpBatch dumpBatch)
+{
+    if (!lossSum.defined() || batchesSinceLossRead == 0)
+    {
+        lossSum = batchLoss.clone();
+    }
+    else
+    {
+        lossSum.add_(batchLoss);
+    }
 
-    outResult.loss = loss.item<float>();
+    // The batch's tensors are only around now, so the check can't wait for the window's read
+    if (g_dumpHighLossBatches.Value())
+    {
+        float currentLoss = batchLoss.item<float>();
+        if (currentLoss > 10.0f)
+        {
+            std::cout << "High loss " << currentLoss << " in this batch" << std::endl;
+            dumpBatch();
+        }
+    }
 
-    //Log("Train batch end\n");
+    if (++batchesSinceLossRead < std::max(1, g_lossReadInterval.Value()))
+    {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    float meanLoss = (lossSum / static_cast<float>(batchesSinceLossRead)).item<float>();
+    batchesSinceLossRead = 0;
+
+    return meanLoss;
+}
+
+// Checks that the kernel reproduces the torch outputs for a decision batch, within float rounding
+template<typename TGrid>
+static void CompareKernelWithTorch(const PlayerInferenceKernel& kernel, const TGrid& input, const std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>& torchOutput)
+{
+    auto torchAction = std::get<0>(torchOutput).reshape({ input.Rows(), 3 }).contiguous();
+    auto torchMove = std::get<1>(torchOutput).reshape({ input.Rows(), 2 }).contiguous();
+    auto torchEntity = std::get<2>(torchOutput).reshape({ input.Rows(), 3 }).contiguous();
+
+    float maxDifference = 0;
+    for (int i = 0; i < input.Rows(); ++i)
+    {
+        float action[3];
+        float move[2];
+        float entity[3];
+        kernel.Evaluate(input[i][0], action, move, entity);
+
+        // Compare log-probabilities, like the torch heads produce
+        auto kernelAction = torch::log_softmax(torch::from_blob(action, { 3 }), 0);
+        auto kernelEntity = torch::log_softmax(torch::from_blob(entity, { 3 }), 0);
+
+        maxDifference = std::max(maxDifference, (kernelAction - torchAction[i]).abs().max().item<float>());
+        maxDifference = std::max(maxDifference, (torch::from_blob(move, { 2 }) - torchMove[i]).abs().max().item<float>());
+        maxDifference = std::max(maxDifference, (kernelEntity - torchEntity[i]).abs().max().item<float>());
+    }
+
+    if (maxDifference > 1e-4f)
+    {
+        std::cout << "Inference kernel differs from torch by up to " << maxDifference << std::endl;
+    }
 }
 
+// A batch of single observations laid out like a Grid with one column
+struct ObservationRows
+{
+    int Rows() const { return static_cast<int>(observations.size()); }
+    int Cols() const { return 1; }
+    const Observation* operator[](int row) const { return &observations[row]; }
+
+    gsl::span<const Observation> observations;
+};
+
 void PlayerNetwork::MakeDecision(Grid<const InputType> input, gsl::span<OutputType> output)
 {
+    PROFILE_ZONE("PlayerNetwork::MakeDecision");
+
+    Decide(input, output);
+}
+
+void PlayerNetwork::DecideBatch(gsl::span<const Observation> inputs, gsl::span<OutputType> outputs)
+{
+    PROFILE_ZONE("PlayerNetwork::DecideBatch");
+
+    Decide(ObservationRows { inputs }, outputs);
+}
+
+template<typename TGrid>
+void PlayerNetwork::Decide(const TGrid& input, gsl::span<OutputType> output)
+{
+    ScopedMetricTimer latencyTimer(g_gameMetrics.decisionLatency);
+
     try
     {
-        torch::Device cpu(torch::kCPU);
-        module->to(cpu);
-        module->eval();
-        auto playerInput = PackIntoTensor(input, [=](auto& sample) { return ConvertPlayer(sample); });
-        auto minionInput = PackIntoTensor(input, [=](auto& sample) { return ConvertMinion(sample); });
-        auto buildingInput = PackIntoTensor(input, [=](auto& sample) { return ConvertBuilding(sample); });
-        auto action = Forward(playerInput, minionInput, buildingInput);
+        // Decision inputs are what the quantized kernel will see, and the only observations decider-only builds get.
+        // The set only has to be a fair sample, so a batch that finds it busy is left out rather than waited on.
+        if (precision != InferencePrecision::Float32)
+        {
+            std::unique_lock<std::mutex> guard(calibrationMutex, std::try_to_lock);
+            if (guard.owns_lock())
+            {
+                for (int i = 0; i < input.Rows(); ++i)
+                {
+                    AddCalibrationSampleLocked(input[i][input.Cols() - 1]);
+                }
+            }
+        }
+
+        auto replica = AcquireInferenceReplica();
+
+        // The kernel only evaluates the latest observation, so sequences still go through torch
+        bool useKernel = g_fastInference.Value() && input.Cols() == 1 && frozenPolicy == nullptr;
+        if (useKernel && !g_validateFastInference.Value())
+        {
+            for (int i = 0; i < output.size(); ++i)
+            {
+                if (replica->quantizedKernel != nullptr)
+                {
+                    replica->quantizedKernel->Decide(input[i][0], output[i]);
+                }
+                else
+                {
+                    replica->kernel->Decide(input[i][0], output[i]);
+                }
+            }
+
+            return;
+        }
+
+        torch::NoGradGuard noGrad;
+
+        // Each decider thread packs into its own staging tensors
+        thread_local PlayerBatchPacker decisionPacker;
+        decisionPacker.PackObservations(input, [](const InputType& observation) -> const InputType& { return observation; });
+
+        auto action = frozenPolicy != nullptr
+            ? RunFrozenPlayerPolicy(*frozenPolicy, decisionPacker.players, decisionPacker.minions, decisionPacker.buildings)
+            : replica->model->Forward(decisionPacker.players, decisionPacker.minions, decisionPacker.buildings);
 
         //std::cout << "choice: " << std::endl << std::get<0>(action) << std::endl;
         //std::cout << "move: " << std::endl << std::get<1>(action) << std::endl;
@@ -289,6 +605,11 @@ void PlayerNetwork::MakeDecision(Grid<const InputType> input, gsl::span<OutputTy
             torch::Tensor entityIndex = std::get<1>(torch::max(std::get<2>(action).index({ i }), 0));
             output[i].entityChoice = *entityIndex.data_ptr<int64_t>();
         }
+
+        if (useKernel)
+        {
+            CompareKernelWithTorch(*replica->kernel, input, action);
+        }
     }
     catch (const std::exception& e)
     {
@@ -304,7 +625,7 @@ void PlayerNetwork::MakeDecision(Grid<const InputType> input, gsl::span<OutputTy
     }
 }
 
-torch::Tensor PlayerNetwork::PartialForward(const torch::Tensor& input, torch::nn::Linear layer1, torch::nn::Linear layer2, torch::nn::Linear layer3)
+torch::Tensor PlayerModelImpl::PartialForward(const torch::Tensor& input, torch::nn::Linear layer1, torch::nn::Linear layer2, torch::nn::Linear layer3)
 {
     try 
     {
@@ -323,7 +644,7 @@ torch::Tensor PlayerNetwork::PartialForward(const torch::Tensor& input, torch::n
     }
 }
 
-std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> PlayerNetwork::Forward(const torch::Tensor& playerInput, const torch::Tensor& minionInput, const torch::Tensor& buildingInput)
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> PlayerModelImpl::Forward(const torch::Tensor& playerInput, const torch::Tensor& minionInput, const torch::Tensor& buildingInput)
 {
     //std::cout << "player: " << playerInput << std::endl;
     //std::cout << "minion: " << minionInput << std::endl;
@@ -357,17 +678,291 @@ std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> PlayerNetwork::Forward(c
     return std::make_tuple(action, move, entity);
 }
 
-PlayerTrainer::PlayerTrainer(Metric* lossMetric)
-    : Trainer<PlayerNetwork>(32, 10000, 1),
-    lossMetric(lossMetric)
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> PlayerNetwork::Forward(const torch::Tensor& playerInput, const torch::Tensor& minionInput, const torch::Tensor& buildingInput)
+{
+    return model->Forward(playerInput, minionInput, buildingInput);
+}
+
+void PlayerNetwork::MoveToDevice(torch::Device newDevice)
+{
+    if (newDevice == device)
+    {
+        return;
+    }
+
+    if (newDevice.is_cpu())
+    {
+        ConfigureCpuBackend();
+    }
+
+    device = newDevice;
+    module->to(device);
+
+    // Adam's moment estimates live on the old device, so the optimizer starts over on the next batch
+    optimizer = nullptr;
+    lossSum = torch::Tensor();
+    batchesSinceLossRead = 0;
+
+    std::cout << "Training the player network on " << device << std::endl;
+}
+
+void PlayerNetwork::PublishInferenceWeights()
+{
+    std::lock_guard<std::mutex> guard(publishMutex);
+    torch::NoGradGuard noGrad;
+
+    // A hot-loaded checkpoint hasn't been copied into the training weights yet. Publishing them now would replace the
+    // checkpoint with the weights it was meant to replace, so wait until TrainBatch has adopted it.
+    if (trainingWeightsStale.load())
+    {
+        return;
+    }
+
+    // Reuse the previous replica's storage if no decider is still running on it
+    auto replica = std::move(spareReplica);
+    if (replica == nullptr || replica.use_count() > 1)
+    {
+        replica = std::make_shared<PlayerInferenceReplica>();
+        replica->model = PlayerModel(std::dynamic_pointer_cast<PlayerModelImpl>(model->clone(torch::kCPU)));
+        replica->model->eval();
+    }
+    else
+    {
+        auto source = model->parameters();
+        auto destination = replica->model->parameters();
+
+        for (size_t i = 0; i < destination.size(); ++i)
+        {
+            destination[i].copy_(source[i]);
+        }
+    }
+
+    SwapInReplica(std::move(replica));
+
+    int checkpointInterval = g_checkpointInterval.Value();
+    if (!g_checkpointPath.Value().empty() && checkpointInterval > 0 && InferenceVersion() % checkpointInterval == 0)
+    {
+        SaveCheckpoint(g_checkpointPath.Value());
+    }
+}
+
+void PlayerNetwork::SwapInReplica(std::shared_ptr<PlayerInferenceReplica> replica)
+{
+    replica->version = inferenceVersion.load(std::memory_order_relaxed) + 1;
+
+    if (replica->kernel == nullptr)
+    {
+        replica->kernel = std::make_shared<PlayerInferenceKernel>();
+    }
+
+    replica->kernel->Export(*replica->model);
+    replica->quantizedKernel = nullptr;
+
+    bool calibrate = false;
+    bool report = false;
+
+    if (precision != InferencePrecision::Float32)
+    {
+        // Until enough observations have been seen there is nothing to calibrate with, so decide in fp32
+        auto ranges = std::atomic_load(&calibratedRanges);
+        if (ranges != nullptr)
+        {
+            replica->quantizedKernel = QuantizePlayerKernel(*replica->kernel, precision, *ranges);
+            awaitingCalibration = false;
+        }
+
+        int reportInterval = g_quantizationReportInterval.Value();
+        calibrate = ranges == nullptr || replica->version % std::max(1, g_calibrationInterval.Value()) == 0;
+        report = reportInterval > 0 && replica->version % reportInterval == 0;
+    }
+
+    auto previous = std::atomic_exchange(&inferenceReplica, std::shared_ptr<const PlayerInferenceReplica>(std::move(replica)));
+    spareReplica = std::const_pointer_cast<PlayerInferenceReplica>(previous);
+    inferenceVersion.fetch_add(1, std::memory_order_release);
+
+    if (calibrate || report)
+    {
+        StartCalibrationTask(std::atomic_load(&inferenceReplica), calibrate, report);
+    }
+}
+
+void PlayerNetwork::StartCalibrationTask(std::shared_ptr<const PlayerInferenceReplica> replica, bool calibrate, bool report)
+{
+    // Versions published while the last one is still running skip theirs
+    if (calibrationTask.valid() && calibrationTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return;
+    }
+
+    // Holding the replica keeps it from being reused as the spare while the task reads its kernels
+    calibrationTask = std::async(std::launch::async, [this, replica, calibrate, report]
+    {
+        std::vector<Observation> calibrationSet;
+
+        {
+            std::lock_guard<std::mutex> guard(calibrationMutex);
+            if (calibrationSamples.size() < MinCalibrationSamples)
+            {
+                return;
+            }
+
+            calibrationSet = calibrationSamples;
+        }
+
+        auto ranges = std::atomic_load(&calibratedRanges);
+        if (calibrate)
+        {
+            auto newRanges = std::make_shared<ActivationRanges>();
+            if (CalibratePlayerKernel(*replica->kernel, calibrationSet, *newRanges))
+            {
+                ranges = newRanges;
+                std::atomic_store(&calibratedRanges, ranges);
+            }
+        }
+
+        if (report && ranges != nullptr)
+        {
+            auto quantizedKernel = replica->quantizedKernel != nullptr
+                ? replica->quantizedKernel
+                : QuantizePlayerKernel(*replica->kernel, precision, *ranges);
+            ReportQuantizationAccuracy(*replica->kernel, *quantizedKernel, calibrationSet);
+        }
+    });
+}
+
+std::shared_ptr<const PlayerInferenceReplica> PlayerNetwork::AcquireInferenceReplica()
+{
+    AdoptCheckpointIfPending();
+    QuantizeOnceCalibrated();
+    return std::atomic_load(&inferenceReplica);
+}
+
+void PlayerNetwork::QuantizeOnceCalibrated()
+{
+    // Publishes quantize too, but decider-only builds never publish, so the first replica quantized with calibrated
+    // ranges is made here instead. This happens once.
+    if (precision == InferencePrecision::Float32 || !awaitingCalibration.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    // Deciders only check in passing, a publish or another decider holding the lock will get to it
+    std::unique_lock<std::mutex> guard(publishMutex, std::try_to_lock);
+    if (!guard.owns_lock() || !awaitingCalibration.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    auto current = std::atomic_load(&inferenceReplica);
+    if (std::atomic_load(&calibratedRanges) == nullptr)
+    {
+        StartCalibrationTask(current, true, false);
+        return;
+    }
+
+    torch::NoGradGuard noGrad;
+    auto replica = std::make_shared<PlayerInferenceReplica>();
+    replica->model = PlayerModel(std::dynamic_pointer_cast<PlayerModelImpl>(current->model->clone(torch::kCPU)));
+    replica->model->eval();
+
+    SwapInReplica(std::move(replica));
+}
+
+void PlayerNetwork::AdoptCheckpointIfPending()
+{
+    if (g_checkpointGeneration.load(std::memory_order_acquire) == checkpointGeneration.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    PlayerModel loaded{ nullptr };
+
+    {
+        std::lock_guard<std::mutex> guard(g_checkpointMutex);
+        auto generation = g_checkpointGeneration.load(std::memory_order_relaxed);
+        if (generation == checkpointGeneration.load(std::memory_order_relaxed))
+        {
+            // Another decider got to it first
+            return;
+        }
+
+        loaded = g_loadedCheckpoint;
+        checkpointGeneration.store(generation, std::memory_order_release);
+    }
+
+    auto replica = std::make_shared<PlayerInferenceReplica>();
+    replica->model = PlayerModel(std::dynamic_pointer_cast<PlayerModelImpl>(loaded->clone(torch::kCPU)));
+    replica->model->eval();
+
+    {
+        std::lock_guard<std::mutex> guard(publishMutex);
+        SwapInReplica(std::move(replica));
+        trainingWeightsStale = true;
+    }
+
+    std::cout << "Player policy now at version " << InferenceVersion() << " (hot-loaded)" << std::endl;
+}
+
+void PlayerNetwork::AddCalibrationSample(const Observation& observation)
+{
+    std::unique_lock<std::mutex> guard(calibrationMutex, std::try_to_lock);
+    if (guard.owns_lock())
+    {
+        AddCalibrationSampleLocked(observation);
+    }
+}
+
+void PlayerNetwork::AddCalibrationSampleLocked(const Observation& observation)
+{
+    ++calibrationSamplesSeen;
+
+    // Reservoir sampling, every observation seen so far is equally likely to be in the set
+    if (calibrationSamples.size() < CalibrationSetSize)
+    {
+        calibrationSamples.push_back(observation);
+    }
+    else
+    {
+        auto index = std::uniform_int_distribution<uint64_t>(0, calibrationSamplesSeen - 1)(calibrationRandom);
+        if (index < CalibrationSetSize)
+        {
+            calibrationSamples[index] = observation;
+        }
+    }
+}
+
+void PlayerNetwork::SaveCheckpoint(const std::string& path)
+{
+    auto replica = std::atomic_load(&inferenceReplica);
+    torch::save(replica->model, path);
+    ExportFrozenPlayerPolicy(*replica->model, path + ".frozen");
+}
+
+PlayerTrainer::PlayerTrainer(MetricsManager* metrics)
+    : Trainer<PlayerNetwork>(TrainingBatchSize, 10000, 1),
+    lossMetric(metrics->GetOrCreateMetric("loss")),
+    prefetchQueueDepthMetric(metrics->GetOrCreateMetric("prefetch-queue-depth")),
+    prefetchStallMetric(metrics->GetOrCreateMetric("prefetch-stall")),
+    stratifiedSamples(SamplesPerActionReservoir, RecentSampleWindow)
 {
     LogStartup();
-    samples = sampleRepository.CreateSampleSet("player-samples");
-    samplesByActionType = samples
-        ->CreateGroupedView<int>()
-        ->GroupBy([=](const SampleType& sample) { return sample.output.actionIndex; });
+    if (uint32_t seed = GetSimulationSeed())
+    {
+        stratifiedSamples.Seed(seed);
+    }
+
+    if (!g_sampleStorePath.Value().empty())
+    {
+        sampleStore = std::make_unique<PlayerSampleStore>();
+        if (!sampleStore->Open(g_sampleStorePath.Value()))
+        {
+            sampleStore = nullptr;
+        }
+    }
 }
 
+PlayerTrainer::~PlayerTrainer() = default;
+
 void PlayerTrainer::LogStartup() const
 {
     std::cout << "Trainer starting" << std::endl;
@@ -382,15 +977,153 @@ void PlayerTrainer::LogStartup() const
 
 void PlayerTrainer::ReceiveSample(const SampleType& sample) 
 {
-    samples->AddSample(sample);
+    g_gameMetrics.samplesReceived.Add();
+
+    stratifiedSamples.Add(sample.output.actionIndex, sample);
+    network->AddCalibrationSample(sample.input);
+
+    if (sampleStore != nullptr)
+    {
+        sampleStore->Append(sample);
+    }
 }
 
 bool PlayerTrainer::TrySelectSequenceSamples(gsl::span<SampleType> outSequence) 
 {
-    return samplesByActionType->TryPickRandomSequence(outSequence);
+    if (prefetcher == nullptr && g_prefetchLoaders.Value() > 0)
+    {
+        // Started here rather than in the constructor since the network isn't attached until then
+        prefetcher = std::make_unique<PlayerBatchPrefetcher>(
+            [=](SampleType* outBatch, int batchSize, int loaderIndex) { return DrawTrainingBatch(outBatch, batchSize, loaderIndex + 1); },
+            TrainingBatchSize,
+            g_prefetchLoaders.Value(),
+            g_prefetchDepth.Value(),
+            prefetchQueueDepthMetric,
+            prefetchStallMetric);
+    }
+
+    if (outSequence.size() != 1)
+    {
+        return TryPickStoredSequence(outSequence, TrainerSampleStream)
+            || stratifiedSamples.TryDrawSequence(outSequence.data(), static_cast<int>(outSequence.size()));
+    }
+
+    if (nextDrawnSample == drawnBatch.size())
+    {
+        nextDrawnSample = 0;
+
+        // Each batch has a single source. When the loaders have one ready, it's handed to the network and the engine
+        // is given the previous batch's samples as placeholders, so nothing is drawn on this thread.
+        if (prefetcher != nullptr && !drawnBatch.empty())
+        {
+            network->preparedBatch = prefetcher->TryTake(network->device);
+        }
+
+        if (network->preparedBatch == nullptr)
+        {
+            drawnBatch.resize(TrainingBatchSize);
+            if (!DrawTrainingBatch(drawnBatch.data(), drawnBatch.size(), TrainerSampleStream))
+            {
+                drawnBatch.clear();
+                return false;
+            }
+        }
+    }
+
+    outSequence[0] = drawnBatch[nextDrawnSample++];
+    return true;
+}
+
+// Seeded from sim-seed and the stream, so that a seeded run reads the same stored samples on every thread
+static std::minstd_rand CreateSampleStreamRandom(int stream)
+{
+    if (uint32_t seed = GetSimulationSeed())
+    {
+        std::seed_seq sequence { seed, static_cast<uint32_t>(stream) };
+        return std::minstd_rand(sequence);
+    }
+
+    return std::minstd_rand(std::random_device{}());
+}
+
+// Every thread always draws for the same stream, so the first call's stream picks the seed
+static std::minstd_rand& SampleStreamRandom(int stream)
+{
+    thread_local std::minstd_rand random = CreateSampleStreamRandom(stream);
+    return random;
+}
+
+bool PlayerTrainer::DrawTrainingBatch(SampleType* outBatch, int batchSize, int stream)
+{
+    const float actionWeights[PlayerSampleStore::ActionCount] =
+    {
+        g_noneActionWeight.Value(),
+        g_movingActionWeight.Value(),
+        g_attackingActionWeight.Value()
+    };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // Only written when the console variable changed, draws read the weights without taking the sampler's lock
+        if (stratifiedSamples.Weight(i) != std::max(actionWeights[i], 0.0f))
+        {
+            stratifiedSamples.SetWeight(i, actionWeights[i]);
+        }
+
+        g_gameMetrics.samplesByAction[i].Set(static_cast<float>(stratifiedSamples.GroupSize(i)));
+    }
+
+    // nn-sample-store-fraction of the batch comes from the whole history on disk and the rest from the recent samples
+    // in memory. Both shares are split between actions by the same weights.
+    std::minstd_rand& random = SampleStreamRandom(stream);
+    int storedCount = 0;
+    if (sampleStore != nullptr)
+    {
+        float fraction = std::min(std::max(g_sampleStoreFraction.Value(), 0.0f), 1.0f);
+        storedCount = static_cast<int>(std::lround(batchSize * fraction));
+        gsl::span<SampleType> storedShare(outBatch, storedCount);
+        if (storedCount > 0 && !sampleStore->TryDrawByAction(actionWeights, random, storedShare))
+        {
+            storedCount = 0;
+        }
+    }
+
+    if (storedCount == batchSize || stratifiedSamples.TryDrawBatch(outBatch + storedCount, batchSize - storedCount))
+    {
+        return true;
+    }
+
+    // Nothing recent to draw from yet, so the store fills the whole batch if it can
+    return sampleStore != nullptr
+        && sampleStore->TryDrawByAction(actionWeights, random, gsl::span<SampleType>(outBatch, batchSize));
+}
+
+bool PlayerTrainer::TryPickStoredSequence(gsl::span<SampleType> outSequence, int stream)
+{
+    // Part of the sequences come uniformly from the whole history on disk, the rest from the recent samples in memory
+    if (sampleStore == nullptr)
+    {
+        return false;
+    }
+
+    std::minstd_rand& random = SampleStreamRandom(stream);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+    uint64_t storedSamples = sampleStore->Size();
+
+    if (storedSamples < outSequence.size() || chance(random) >= g_sampleStoreFraction.Value())
+    {
+        return false;
+    }
+
+    std::uniform_int_distribution<uint64_t> firstIndex(0, storedSamples - outSequence.size());
+    return sampleStore->TryReadSequence(firstIndex(random), outSequence);
 }
 
 void PlayerTrainer::OnTrainingComplete(const StrifeML::TrainingBatchResult& result)
 {
-    lossMetric->Add(result.loss);
+    // The network only reads the loss back from the device every few batches
+    if (!std::isnan(result.loss))
+    {
+        lossMetric->Add(result.loss);
+    }
 }
\ No newline at end of file
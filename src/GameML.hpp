@@ -4,48 +4,100 @@
 #include "ML/ML.hpp"
 #include "TensorPacking.hpp"
 #include <torch/torch.h>
+#include <torch/script.h>
 #include "ML/GridSensor.hpp"
 
 #include "Tools/MetricsManager.hpp"
+#include "StratifiedSampler.hpp"
 
-struct PlayerObservation : StrifeML::ISerializable
-{
-    void Serialize(StrifeML::ObjectSerializer& serializer) override;
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <random>
 
-    Vector2 position;
-    Vector2 velocity;
-    float health;
-};
+// Number of entities of each kind the network sees, and the features it sees for each of them
+constexpr int MaxObservedPlayers = 4;
+constexpr int MaxObservedMinions = 12;
+constexpr int MaxObservedBuildings = 4;
 
-struct MinionObservation : StrifeML::ISerializable
+constexpr int PlayerFeatureCount = 5;
+constexpr int MinionFeatureCount = 5;
+constexpr int BuildingFeatureCount = 3;
+
+// Sensor priorities of each entity type. They are registered with the SensorObjectDefinition and also decide which
+// entities get an observation slot: a higher priority entity is picked over a lower priority one at the same distance.
+namespace SensorPriority
 {
-    void Serialize(StrifeML::ObjectSerializer& serializer) override;
+    constexpr float Player = 1.0f;
+    constexpr float Tilemap = 0.0f;
+    constexpr float Castle = 0.7f;
+    constexpr float Tower = 0.9f;
+    constexpr float Minion = 0.8f;
+}
+
+// Observed players and minions, stored as a fixed-capacity structure of arrays so that an observation never allocates
+template<int Capacity>
+struct ObservedUnits
+{
+    static constexpr int capacity = Capacity;
+
+    void Clear() { count = 0; }
+
+    bool TryAdd(Vector2 unitPosition, Vector2 unitVelocity, float unitHealth)
+    {
+        if (count == Capacity)
+        {
+            return false;
+        }
+
+        position[count] = unitPosition;
+        velocity[count] = unitVelocity;
+        health[count] = unitHealth;
+        ++count;
+
+        return true;
+    }
 
-    Vector2 position;
-    Vector2 velocity;
-    float health;
+    int count = 0;
+    Vector2 position[Capacity];
+    Vector2 velocity[Capacity];
+    float health[Capacity] = { };
 };
 
-struct BuildingObservation : StrifeML::ISerializable
+template<int Capacity>
+struct ObservedBuildings
 {
-    void Serialize(StrifeML::ObjectSerializer& serializer) override;
+    static constexpr int capacity = Capacity;
+
+    void Clear() { count = 0; }
+
+    bool TryAdd(Vector2 buildingPosition, float buildingHealth)
+    {
+        if (count == Capacity)
+        {
+            return false;
+        }
+
+        position[count] = buildingPosition;
+        health[count] = buildingHealth;
+        ++count;
+
+        return true;
+    }
 
-    Vector2 position;
-    float health;
+    int count = 0;
+    Vector2 position[Capacity];
+    float health[Capacity] = { };
 };
 
 struct Observation : StrifeML::ISerializable
 {
     void Serialize(StrifeML::ObjectSerializer& serializer) override;
 
-    std::vector<PlayerObservation> players;
-    std::vector<MinionObservation> minions;
-    std::vector<BuildingObservation> buildings;
-
-    //temp bug fix:
-    /*PlayerObservation nearestPlayer;
-    MinionObservation nearestMinion;
-    BuildingObservation nearestBuilding;*/
+    ObservedUnits<MaxObservedPlayers> players;
+    ObservedUnits<MaxObservedMinions> minions;
+    ObservedBuildings<MaxObservedBuildings> buildings;
 };
 
 struct TrainingLabel : StrifeML::ISerializable
@@ -57,8 +109,150 @@ struct TrainingLabel : StrifeML::ISerializable
     int entityChoice;
 };
 
-struct PlayerNetwork : StrifeML::NeuralNetwork<Observation, TrainingLabel>
+// Packs a whole batch of observations (and labels) in a single pass, writing straight into staging tensors. On the CPU
+// the staging tensors are reused from batch to batch. When pinned, a fresh tensor is taken from the pinned host
+// allocator each batch instead, since it only recycles a block once the asynchronous copy out of it has finished.
+class PlayerBatchPacker
+{
+public:
+    void SetPinMemory(bool pin) { pinMemory = pin; }
+
+    // TGrid is a Grid of samples, or anything else with Rows(), Cols() and [row][col]
+    template<typename TGrid, typename TGetObservation>
+    void PackObservations(const TGrid& input, TGetObservation getObservation);
+
+    template<typename TGrid>
+    void PackLabels(const TGrid& input);
+
+    // Views of the staging tensors holding the last packed batch
+    torch::Tensor players;
+    torch::Tensor minions;
+    torch::Tensor buildings;
+    torch::Tensor actionLabels;
+    torch::Tensor moveLabels;
+    torch::Tensor entityLabels;
+
+private:
+    torch::Tensor Stage(torch::Tensor& staging, torch::IntArrayRef shape, torch::ScalarType type);
+
+    template<int Capacity>
+    static float* PackUnits(float* out, const ObservedUnits<Capacity>& units);
+
+    template<int Capacity>
+    static float* PackBuildings(float* out, const ObservedBuildings<Capacity>& buildings);
+
+    torch::Tensor playerStaging;
+    torch::Tensor minionStaging;
+    torch::Tensor buildingStaging;
+    torch::Tensor actionStaging;
+    torch::Tensor moveStaging;
+    torch::Tensor entityStaging;
+    bool pinMemory = false;
+};
+
+template<int Capacity>
+float* PlayerBatchPacker::PackUnits(float* out, const ObservedUnits<Capacity>& units)
+{
+    for (int i = 0; i < units.count; ++i)
+    {
+        out[0] = units.position[i].x;
+        out[1] = units.position[i].y;
+        out[2] = units.velocity[i].x;
+        out[3] = units.velocity[i].y;
+        out[4] = units.health[i];
+        out += 5;
+    }
+
+    // Empty slots are zeroed in one go
+    int padding = (Capacity - units.count) * 5;
+    std::fill(out, out + padding, 0.0f);
+
+    return out + padding;
+}
+
+template<int Capacity>
+float* PlayerBatchPacker::PackBuildings(float* out, const ObservedBuildings<Capacity>& buildings)
+{
+    for (int i = 0; i < buildings.count; ++i)
+    {
+        out[0] = buildings.position[i].x;
+        out[1] = buildings.position[i].y;
+        out[2] = buildings.health[i];
+        out += 3;
+    }
+
+    int padding = (Capacity - buildings.count) * 3;
+    std::fill(out, out + padding, 0.0f);
+
+    return out + padding;
+}
+
+template<typename TGrid, typename TGetObservation>
+void PlayerBatchPacker::PackObservations(const TGrid& input, TGetObservation getObservation)
+{
+    int64_t rows = input.Rows();
+    int64_t cols = input.Cols();
+
+    players = Stage(playerStaging, { rows, cols, MaxObservedPlayers, PlayerFeatureCount }, torch::kFloat32);
+    minions = Stage(minionStaging, { rows, cols, MaxObservedMinions, MinionFeatureCount }, torch::kFloat32);
+    buildings = Stage(buildingStaging, { rows, cols, MaxObservedBuildings, BuildingFeatureCount }, torch::kFloat32);
+
+    float* playerOut = players.data_ptr<float>();
+    float* minionOut = minions.data_ptr<float>();
+    float* buildingOut = buildings.data_ptr<float>();
+
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int col = 0; col < cols; ++col)
+        {
+            const Observation& observation = getObservation(input[row][col]);
+
+            playerOut = PackUnits(playerOut, observation.players);
+            minionOut = PackUnits(minionOut, observation.minions);
+            buildingOut = PackBuildings(buildingOut, observation.buildings);
+        }
+    }
+}
+
+template<typename TGrid>
+void PlayerBatchPacker::PackLabels(const TGrid& input)
 {
+    int64_t rows = input.Rows();
+    int64_t cols = input.Cols();
+
+    actionLabels = Stage(actionStaging, { rows, cols }, torch::kInt64);
+    moveLabels = Stage(moveStaging, { rows, cols, 2 }, torch::kFloat32);
+    entityLabels = Stage(entityStaging, { rows, cols }, torch::kInt64);
+
+    int64_t* actionOut = actionLabels.data_ptr<int64_t>();
+    float* moveOut = moveLabels.data_ptr<float>();
+    int64_t* entityOut = entityLabels.data_ptr<int64_t>();
+
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int col = 0; col < cols; ++col)
+        {
+            const TrainingLabel& label = input[row][col].output;
+
+            *actionOut++ = label.actionIndex;
+            *moveOut++ = label.moveCoord.x;
+            *moveOut++ = label.moveCoord.y;
+            *entityOut++ = label.entityChoice;
+        }
+    }
+}
+
+// The layers of the player policy. Kept separate from PlayerNetwork so that deciders can run on their own copy of the
+// weights while the trainer keeps updating the original.
+struct PlayerModelImpl : torch::nn::Cloneable<PlayerModelImpl>
+{
+    PlayerModelImpl();
+
+    void reset() override;
+
+    torch::Tensor PartialForward(const torch::Tensor& input, torch::nn::Linear layer1, torch::nn::Linear layer2, torch::nn::Linear layer3);
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> Forward(const torch::Tensor& playerInput, const torch::Tensor& minionInput, const torch::Tensor& buildingInput);
+
     torch::nn::Linear playerEmbed1{ nullptr }, playerEmbed2{ nullptr }, playerEmbed3{ nullptr };
     torch::nn::Linear minionEmbed1{ nullptr }, minionEmbed2{ nullptr }, minionEmbed3{ nullptr };
     torch::nn::Linear buildingEmbed1{ nullptr }, buildingEmbed2{ nullptr }, buildingEmbed3{ nullptr };
@@ -66,17 +260,114 @@ struct PlayerNetwork : StrifeML::NeuralNetwork<Observation, TrainingLabel>
     torch::nn::Linear action1{ nullptr }, action2{ nullptr }, action3{ nullptr };
     torch::nn::Linear move1{ nullptr }, move2{ nullptr }, move3{ nullptr };
     torch::nn::Linear entity1{ nullptr }, entity2{ nullptr }, entity3{ nullptr };
-    torch::Device device = torch::Device(torch::kCUDA);
-    std::shared_ptr<torch::optim::Adam> optimizer;
+};
+
+TORCH_MODULE(PlayerModel);
+
+struct PlayerInferenceKernel;
+struct IQuantizedPlayerKernel;
+struct PreparedTrainingBatch;
+struct ActivationRanges;
+
+enum class InferencePrecision
+{
+    Float32,
+    Int8,           // int8 weights and activations
+    Int8Int16       // int8 weights, int16 activations
+};
+
+// A read-only snapshot of the policy weights used for deciding. Once published, a replica is never modified, so any
+// number of deciders can run it while the trainer prepares the next one.
+struct PlayerInferenceReplica
+{
+    PlayerModel model{ nullptr };
+    std::shared_ptr<PlayerInferenceKernel> kernel;     // The same weights, exported for the SIMD decision path
+    std::shared_ptr<IQuantizedPlayerKernel> quantizedKernel;   // Set when deciding at reduced precision
+    uint64_t version = 0;
+};
+
+struct PlayerNetwork : StrifeML::NeuralNetwork<Observation, TrainingLabel>
+{
+    PlayerModel model{ nullptr };
+    torch::Device device = torch::Device(torch::kCPU);      // Chosen at construction from nn-device
+    InferencePrecision precision = InferencePrecision::Float32;     // Chosen at construction from nn-precision
+    std::shared_ptr<torch::optim::Adam> optimizer;    // Created by the first training batch
+
+    // A frozen TorchScript policy loaded from nn-frozen-policy, used for every decision when set (decider-only builds)
+    std::shared_ptr<torch::jit::Module> frozenPolicy;
+
+    // Set by the trainer when the next batch comes from its loader threads, in which case the batch TrainBatch is given
+    // only holds placeholders
+    std::shared_ptr<PreparedTrainingBatch> preparedBatch;
+
+    // Running loss statistics, kept on the training device between reads
+    torch::Tensor lossSum;
+    int batchesSinceLossRead = 0;
 
     PlayerNetwork();
 
     void TrainBatch(Grid<const SampleType> input, StrifeML::TrainingBatchResult& outResult) override;
     void MakeDecision(Grid<const InputType> input, gsl::span<OutputType> output) override;
-    torch::Tensor PlayerNetwork::PartialForward(const torch::Tensor& input, torch::nn::Linear layer1, torch::nn::Linear layer2, torch::nn::Linear layer3);
+
+    // Decides on observations that weren't gathered into a Grid by the engine, one decision per observation
+    void DecideBatch(gsl::span<const Observation> inputs, gsl::span<OutputType> outputs);
     std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> Forward(const torch::Tensor& playerInput, const torch::Tensor& minionInput, const torch::Tensor& buildingInput);
+
+    // Copies the training weights into a CPU replica and makes it the one deciders use
+    void PublishInferenceWeights();
+    std::shared_ptr<const PlayerInferenceReplica> AcquireInferenceReplica();
+    uint64_t InferenceVersion() const { return inferenceVersion.load(std::memory_order_acquire); }
+
+    void SaveCheckpoint(const std::string& path);
+
+    // Keeps a uniform sample of the observations seen so far, trained on or decided, used to calibrate reduced precision
+    // inference. Skips the observation if another thread is adding one.
+    void AddCalibrationSample(const Observation& observation);
+    void MoveToDevice(torch::Device newDevice);
+
+private:
+    template<typename TGrid>
+    void Decide(const TGrid& input, gsl::span<OutputType> output);
+
+    // Returns the mean loss since the last read, or NaN if it isn't time to synchronize with the device yet
+    template<typename TDumpBatch>
+    float ReadLossIfDue(const torch::Tensor& batchLoss, TDumpBatch dumpBatch);
+
+    void AddCalibrationSampleLocked(const Observation& observation);
+    void QuantizeOnceCalibrated();
+
+    // Called under publishMutex. Quantizes the replica with the last calibrated ranges, leaving calibration and the
+    // accuracy report to calibrationTask.
+    void SwapInReplica(std::shared_ptr<PlayerInferenceReplica> replica);
+    void StartCalibrationTask(std::shared_ptr<const PlayerInferenceReplica> replica, bool calibrate, bool report);
+    void AdoptCheckpointIfPending();
+
+    std::shared_ptr<const PlayerInferenceReplica> inferenceReplica;     // Only accessed through std::atomic_load/store
+    std::shared_ptr<PlayerInferenceReplica> spareReplica;               // The previous replica, reused once no decider holds it
+    std::atomic<uint64_t> inferenceVersion { 0 };
+    std::mutex publishMutex;
+    std::atomic<uint64_t> checkpointGeneration { 0 };
+    int trainStepsSincePublish = 0;
+    torch::DeviceType requestedDeviceType = torch::kCUDA;
+    std::atomic<bool> trainingWeightsStale { false };
+
+    PlayerBatchPacker trainingPacker;
+
+    std::mutex calibrationMutex;
+    std::vector<Observation> calibrationSamples;
+    uint64_t calibrationSamplesSeen = 0;
+    std::minstd_rand calibrationRandom;
+    std::shared_ptr<const ActivationRanges> calibratedRanges;   // Only accessed through std::atomic_load/store
+    std::atomic<bool> awaitingCalibration { true };     // Until the first quantized replica is published
+
+    // Runs the float kernel over a copy of the calibration set off the publish path. Started and checked under
+    // publishMutex. Declared last so the destructor waits for it before anything it uses is torn down.
+    std::future<void> calibrationTask;
 };
 
+class PlayerSampleStore;
+class PlayerBatchPrefetcher;
+
 struct PlayerDecider : StrifeML::Decider<PlayerNetwork>
 {
 
@@ -84,14 +375,32 @@ struct PlayerDecider : StrifeML::Decider<PlayerNetwork>
 
 struct PlayerTrainer : StrifeML::Trainer<PlayerNetwork>
 {
-    PlayerTrainer(Metric* lossMetric);
+    PlayerTrainer(MetricsManager* metrics);
+    ~PlayerTrainer();
 
     void LogStartup() const;
     void ReceiveSample(const SampleType& sample) override;
     bool TrySelectSequenceSamples(gsl::span<SampleType> outSequence) override;
     void OnTrainingComplete(const StrifeML::TrainingBatchResult& result) override;
 
-    StrifeML::SampleSet<SampleType>* samples;
-    StrifeML::GroupedSampleView<SampleType, int>* samplesByActionType;
+    // Streams are the trainer thread (TrainerSampleStream) and each loader thread (its index + 1)
+    static constexpr int TrainerSampleStream = 0;
+    bool DrawTrainingBatch(SampleType* outBatch, int batchSize, int stream);
+    bool TryPickStoredSequence(gsl::span<SampleType> outSequence, int stream);
+
     Metric* lossMetric;
+    Metric* prefetchQueueDepthMetric;
+    Metric* prefetchStallMetric;
+
+    // The recent samples, grouped by action. Single-sample sequences are served from a batch drawn from it in one go,
+    // longer ones are drawn from it one at a time.
+    StratifiedSampler<SampleType, 3> stratifiedSamples;
+    std::vector<SampleType> drawnBatch;
+    int nextDrawnSample = 0;
+
+    // Every sample ever received, on disk when nn-sample-store is set. The in-memory set only keeps the latest ones.
+    std::unique_ptr<PlayerSampleStore> sampleStore;
+
+    // Declared last so the loader threads stop before anything they draw from is destroyed
+    std::unique_ptr<PlayerBatchPrefetcher> prefetcher;
 };
\ No newline at end of file
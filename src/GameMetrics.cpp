@@ -0,0 +1,264 @@
+#include "GameMetrics.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "Tools/ConsoleVar.hpp"
+#include "Tools/MetricsManager.hpp"
+
+ConsoleVar<std::string> g_metricsPath("metrics-path", "");
+ConsoleVar<float> g_metricsInterval("metrics-interval", 10.0f);
+ConsoleVar<int> g_metricsMaxFileMb("metrics-max-file-mb", 64);
+
+GameMetrics g_gameMetrics;
+
+static int64_t NowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MetricHistogram::Record(float microseconds)
+{
+    int bucket = microseconds <= 1.0f
+        ? 0
+        : std::min(BucketCount - 1, static_cast<int>(std::log2(microseconds) * 4.0f) + 1);
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    float currentMax = max.load(std::memory_order_relaxed);
+    while (microseconds > currentMax && !max.compare_exchange_weak(currentMax, microseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+MetricHistogram::Summary MetricHistogram::Drain()
+{
+    uint64_t counts[BucketCount];
+    Summary summary;
+
+    for (int i = 0; i < BucketCount; ++i)
+    {
+        counts[i] = buckets[i].exchange(0, std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+
+    summary.max = max.exchange(0, std::memory_order_relaxed);
+
+    // Each percentile reports the upper bound of the bucket it falls in
+    auto percentile = [&](double fraction)
+    {
+        uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * summary.count));
+        uint64_t seen = 0;
+        for (int i = 0; i < BucketCount; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank && seen > 0)
+            {
+                return std::min(summary.max, std::exp2(i / 4.0f));
+            }
+        }
+
+        return summary.max;
+    };
+
+    summary.p50 = percentile(0.5);
+    summary.p99 = percentile(0.99);
+
+    return summary;
+}
+
+ScopedMetricTimer::ScopedMetricTimer(MetricHistogram& histogram)
+    : histogram(histogram),
+    start(NowMicroseconds())
+{
+}
+
+ScopedMetricTimer::~ScopedMetricTimer()
+{
+    histogram.Record(static_cast<float>(NowMicroseconds() - start));
+}
+
+// In the order Export fills in their values
+static const char* const ExportedMetricNames[] =
+{
+    "samples-per-second",
+    "batches-per-second",
+    "decisions-skipped",
+    "decision-latency-p50-us",
+    "decision-latency-p99-us",
+    "tick-time-p50-us",
+    "tick-time-p99-us",
+    "samples-none",
+    "samples-moving",
+    "samples-attacking",
+    "players",
+    "minions",
+    "towers",
+    "castles",
+    "fireballs",
+};
+
+static constexpr int ExportedMetricCount = sizeof(ExportedMetricNames) / sizeof(ExportedMetricNames[0]);
+
+MetricsExporter* g_metricsExporter = nullptr;
+
+MetricsExporter::MetricsExporter(MetricsManager* metricsManager)
+{
+    for (auto name : ExportedMetricNames)
+    {
+        metrics.push_back(metricsManager->GetOrCreateMetric(name));
+    }
+
+    SyncSettings();
+    g_metricsExporter = this;
+
+    thread = std::thread([=] { Run(); });
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    g_metricsExporter = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+
+    stopRequested.notify_all();
+    thread.join();
+}
+
+void MetricsExporter::SyncSettings()
+{
+    Settings current;
+    current.path = g_metricsPath.Value();
+    current.interval = g_metricsInterval.Value();
+    current.maxFileMb = g_metricsMaxFileMb.Value();
+
+    std::lock_guard<std::mutex> guard(mutex);
+    settings = std::move(current);
+}
+
+void MetricsExporter::Run()
+{
+    auto windowStart = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        Settings current;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto interval = std::chrono::duration<float>(std::max(0.1f, settings.interval));
+            if (stopRequested.wait_for(lock, interval, [=] { return stopping; }))
+            {
+                return;
+            }
+
+            current = settings;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        Export(std::chrono::duration<float>(now - windowStart).count(), current);
+        windowStart = now;
+    }
+}
+
+void MetricsExporter::Export(float windowSeconds, const Settings& settings)
+{
+    auto decisionLatency = g_gameMetrics.decisionLatency.Drain();
+    auto tickTime = g_gameMetrics.tickTime.Drain();
+
+    float values[ExportedMetricCount] =
+    {
+        g_gameMetrics.samplesReceived.Drain() / windowSeconds,
+        g_gameMetrics.batchesTrained.Drain() / windowSeconds,
+        static_cast<float>(g_gameMetrics.decisionsSkipped.Drain()),
+        decisionLatency.p50,
+        decisionLatency.p99,
+        tickTime.p50,
+        tickTime.p99,
+        g_gameMetrics.samplesByAction[0].Get(),
+        g_gameMetrics.samplesByAction[1].Get(),
+        g_gameMetrics.samplesByAction[2].Get(),
+        g_gameMetrics.playerCount.Get(),
+        g_gameMetrics.minionCount.Get(),
+        g_gameMetrics.towerCount.Get(),
+        g_gameMetrics.castleCount.Get(),
+        g_gameMetrics.fireballCount.Get(),
+    };
+
+    for (int i = 0; i < ExportedMetricCount; ++i)
+    {
+        metrics[i]->Add(values[i]);
+    }
+
+    if (settings.path.empty())
+    {
+        return;
+    }
+
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::ostringstream row;
+    std::ostringstream header;
+    bool csv = settings.path.size() >= 4
+        && settings.path.compare(settings.path.size() - 4, 4, ".csv") == 0;
+
+    if (csv)
+    {
+        header << "timestamp-ms";
+        row << timestamp;
+        for (int i = 0; i < ExportedMetricCount; ++i)
+        {
+            header << "," << ExportedMetricNames[i];
+            row << "," << values[i];
+        }
+    }
+    else
+    {
+        row << "{\"timestamp-ms\":" << timestamp;
+        for (int i = 0; i < ExportedMetricCount; ++i)
+        {
+            row << ",\"" << ExportedMetricNames[i] << "\":" << values[i];
+        }
+
+        row << "}";
+    }
+
+    AppendToFile(row.str(), header.str(), settings);
+}
+
+void MetricsExporter::AppendToFile(const std::string& row, const std::string& csvHeader, const Settings& settings)
+{
+    const std::string& path = settings.path;
+
+    std::streamoff existingSize = 0;
+    {
+        std::ifstream existing(path, std::ios::binary | std::ios::ate);
+        if (existing)
+        {
+            existingSize = existing.tellg();
+        }
+    }
+
+    if (existingSize >= static_cast<std::streamoff>(settings.maxFileMb) * 1024 * 1024)
+    {
+        std::string rolledPath = path + ".1";
+        std::remove(rolledPath.c_str());
+        std::rename(path.c_str(), rolledPath.c_str());
+        existingSize = 0;
+    }
+
+    std::ofstream file(path, std::ios::app);
+    if (!csvHeader.empty() && existingSize == 0)
+    {
+        file << csvHeader << "\n";
+    }
+
+    file << row << std::endl;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MetricsManager;
+class Metric;
+
+// Lock-free metric primitives. Writers only do relaxed atomic adds and stores, so they're safe to update from the game,
+// decider, trainer and loader threads at any rate. The exporter drains them once per window.
+class MetricCounter
+{
+public:
+    void Add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t Drain() { return value.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value { 0 };
+};
+
+class MetricGauge
+{
+public:
+    void Set(float newValue) { value.store(newValue, std::memory_order_relaxed); }
+    float Get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<float> value { 0 };
+};
+
+// Log-scaled buckets with four per doubling, so percentiles are within ~19% of the true value from 1us to over an hour
+class MetricHistogram
+{
+public:
+    struct Summary
+    {
+        uint64_t count = 0;
+        float p50 = 0;
+        float p99 = 0;
+        float max = 0;
+    };
+
+    void Record(float microseconds);
+    Summary Drain();
+
+private:
+    static constexpr int BucketCount = 128;
+
+    std::atomic<uint64_t> buckets[BucketCount] = { };
+    std::atomic<float> max { 0 };
+};
+
+// Times a scope into a histogram
+class ScopedMetricTimer
+{
+public:
+    explicit ScopedMetricTimer(MetricHistogram& histogram);
+    ~ScopedMetricTimer();
+
+private:
+    MetricHistogram& histogram;
+    int64_t start;
+};
+
+struct GameMetrics
+{
+    MetricCounter samplesReceived;
+    MetricCounter batchesTrained;
+    MetricCounter decisionsSkipped;     // Async decisions whose player was destroyed before they were due
+    MetricHistogram decisionLatency;
+    MetricHistogram tickTime;           // Duration of each fixed-update step, entities and physics
+
+    MetricGauge samplesByAction[3];     // Reservoir occupancy of the None, Moving and Attacking groups
+
+    MetricGauge playerCount;
+    MetricGauge minionCount;
+    MetricGauge towerCount;
+    MetricGauge castleCount;
+    MetricGauge fireballCount;
+};
+
+extern GameMetrics g_gameMetrics;
+
+// Drains g_gameMetrics every metrics-interval seconds into the MetricsManager, and appends a row to metrics-path when
+// set: JSON lines, or CSV if the path ends in .csv. The file rolls over to <path>.1 once it reaches metrics-max-file-mb.
+// Exports run on their own thread, which never touches the MetricsManager's registry or the console variables: metrics
+// are created up front, and the settings are copied over by SyncSettings on the game thread.
+class MetricsExporter
+{
+public:
+    explicit MetricsExporter(MetricsManager* metricsManager);
+    ~MetricsExporter();
+
+    // Copies the metrics-* console variables for the export thread. Called on the game thread.
+    void SyncSettings();
+
+private:
+    struct Settings
+    {
+        std::string path;
+        float interval = 10.0f;
+        int maxFileMb = 64;
+    };
+
+    void Run();
+    void Export(float windowSeconds, const Settings& settings);
+    void AppendToFile(const std::string& row, const std::string& csvHeader, const Settings& settings);
+
+    std::vector<Metric*> metrics;
+    Settings settings;              // Guarded by mutex
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable stopRequested;
+    bool stopping = false;
+};
+
+extern MetricsExporter* g_metricsExporter;     // Set while the game has an exporter
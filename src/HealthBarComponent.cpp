@@ -1,8 +1,11 @@
 #include "HealthBarComponent.hpp"
 #include "Renderer/Renderer.hpp"
+#include "Profiler.hpp"
 
 void HealthBarComponent::Render(Renderer* renderer)
 {
+    PROFILE_ZONE("HealthBarComponent::Render");
+
     Vector2 healthBarSize(32, 4);
     renderer->RenderRectangle(Rectangle(
         owner->Center() + offsetFromCenter - healthBarSize / 2,
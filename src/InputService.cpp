@@ -8,6 +8,11 @@
 #include "TowerEntity.hpp"
 #include "MinionEntity.hpp"
 #include "TeamComponent.hpp"
+#include "TeamRegistryService.hpp"
+#include "FireballEntity.hpp"
+#include "GameMetrics.hpp"
+#include "Profiler.hpp"
+#include "PlayerNeuralNetworkService.hpp"
 
 InputButton g_quit = InputButton(SDL_SCANCODE_ESCAPE);
 InputButton g_upButton(SDL_SCANCODE_W);
@@ -19,6 +24,13 @@ void InputService::ReceiveEvent(const IEntityEvent& ev)
 {
     if (ev.Is<SceneLoadedEvent>())
     {
+        recording = SimulationRecording::CreateFromConsoleVars();
+
+        // First, so that the services it steps are up to date for every other entity's fixed update
+        SimulationStepEntity* step = scene->CreateEntity<SimulationStepEntity>(Vector2(0, 0));
+        step->inputService = this;
+        simulationStep = step;
+
         CastleEntity* castle1 = scene->CreateEntity<CastleEntity>(Vector2(327.5, 2080));
         CastleEntity* castle2 = scene->CreateEntity<CastleEntity>(Vector2(3832.5, 2080));
         TowerEntity* tower1 = scene->CreateEntity<TowerEntity>(Vector2(1260, 1997));
@@ -41,6 +53,7 @@ void InputService::ReceiveEvent(const IEntityEvent& ev)
     }
     if (ev.Is<UpdateEvent>())
     {
+        RecordSceneMetrics();
         HandleInput();
     }
     else if (auto renderEvent = ev.Is<RenderEvent>())
@@ -61,14 +74,34 @@ void InputService::HandleInput()
         return;
     }
 
-    auto mouse = scene->GetEngine()->GetInput()->GetMouse();
+    // Replays apply the recorded mouse from the fixed step instead, see ReplayInputs
+    if (recording != nullptr && recording->IsReplaying())
+    {
+        return;
+    }
+
+    RecordedMouse mouse;
+    auto input = scene->GetEngine()->GetInput()->GetMouse();
+    mouse.leftPressed = input->LeftPressed();
+    mouse.rightPressed = input->RightPressed();
+    mouse.worldPosition = scene->GetCamera()->ScreenToWorld(input->MousePosition());
 
-    if (mouse->LeftPressed())
+    if (recording != nullptr)
     {
-        for (auto player : players)
+        recording->Record(SimulationStepIndex(), mouse);
+    }
+
+    ApplyMouse(mouse);
+}
+
+void InputService::ApplyMouse(const RecordedMouse& mouse)
+{
+    if (mouse.leftPressed)
+    {
+        bool selected = false;
+        scene->GetService<TeamRegistryService>()->ForEach<PlayerEntity>(0, [&](PlayerEntity* player)
         {
-            if (player->Bounds().ContainsPoint(scene->GetCamera()->ScreenToWorld(mouse->MousePosition()))
-                && player->playerId == 0)
+            if (!selected && player->Bounds().ContainsPoint(mouse.worldPosition))
             {
                 PlayerEntity* oldPlayer;
                 if (activePlayer.TryGetValue(oldPlayer))
@@ -81,9 +114,9 @@ void InputService::HandleInput()
 
                 scene->GetCameraFollower()->FollowEntity(player);
 
-                break;
+                selected = true;
             }
-        }
+        });
     }
 
     PlayerEntity* self;
@@ -93,7 +126,7 @@ void InputService::HandleInput()
         self->SetMoveDirection(MoveDirectionToVector2(direction) * 200);
         self->lastDirection = direction;*/
 
-        if (mouse->RightPressed())
+        if (mouse.rightPressed)
         {
             for (auto entity : scene->GetEntities())
             {
@@ -102,13 +135,13 @@ void InputService::HandleInput()
                     continue;
                 }
 
-                if (entity->Bounds().ContainsPoint(scene->GetCamera()->ScreenToWorld(mouse->MousePosition())))
+                if (entity->Bounds().ContainsPoint(mouse.worldPosition))
                 {
                     self->Attack(entity);
                     break;
                 }
 
-                self->MoveTo(scene->GetCamera()->ScreenToWorld(mouse->MousePosition()));
+                self->MoveTo(mouse.worldPosition);
             }
         }
     }
@@ -119,8 +152,83 @@ void InputService::HandleInput()
     
 }
 
+void InputService::ReplayInputs(uint64_t stepIndex)
+{
+    if (recording == nullptr || !recording->IsReplaying())
+    {
+        return;
+    }
+
+    recording->Replay(
+        stepIndex,
+        [&](int playerEntityId, const TrainingLabel& decision)
+        {
+            for (auto player : scene->GetEntitiesOfType<PlayerEntity>())
+            {
+                if (player->id == playerEntityId)
+                {
+                    nnService->ApplyDecision(player, decision);
+                    break;
+                }
+            }
+        },
+        [&](const RecordedMouse& mouse)
+        {
+            ApplyMouse(mouse);
+        });
+}
+
+uint64_t InputService::SimulationStepIndex()
+{
+    SimulationStepEntity* step;
+    return simulationStep.TryGetValue(step) ? step->StepIndex() : 0;
+}
+
+void InputService::RecordSceneMetrics()
+{
+    // The last fixed step of the frame ends here, before the update's own work
+    SimulationStepEntity* step;
+    if (simulationStep.TryGetValue(step))
+    {
+        step->EndStepTiming();
+    }
+
+    // Fireballs have no team, so counting them walks every fireball. It's only done every so often.
+    if (++updatesSinceEntityCount < 60)
+    {
+        return;
+    }
+
+    updatesSinceEntityCount = 0;
+
+    if (g_metricsExporter != nullptr)
+    {
+        g_metricsExporter->SyncSettings();
+    }
+
+    auto countEntities = [=](auto entities)
+    {
+        int count = 0;
+        for (auto it = entities.begin(); it != entities.end(); ++it)
+        {
+            ++count;
+        }
+
+        return static_cast<float>(count);
+    };
+
+    auto registry = scene->GetService<TeamRegistryService>();
+    g_gameMetrics.playerCount.Set(registry->CountAllTeams<PlayerEntity>());
+    g_gameMetrics.minionCount.Set(registry->CountAllTeams<MinionEntity>());
+    g_gameMetrics.towerCount.Set(registry->CountAllTeams<TowerEntity>());
+    g_gameMetrics.castleCount.Set(registry->CountAllTeams<CastleEntity>());
+    g_gameMetrics.fireballCount.Set(countEntities(scene->GetEntitiesOfType<FireballEntity>()));
+}
+
 void InputService::Render(Renderer* renderer)
 {
+    PROFILE_ZONE("InputService::Render");
+
     PlayerEntity* currentPlayer;
     if (activePlayer.TryGetValue(currentPlayer))
     {
@@ -142,10 +250,10 @@ MoveDirection InputService::GetInputDirection()
 void InputService::SpawnPlayer(CastleEntity* spawn, int playerId)
 {
     spawn->playerId = playerId;
-    spawn->tower->playerId = playerId;
-    spawn->team->teamId = playerId;
-    spawn->tower->team->teamId = playerId;
-    spawn->minionSpawner->team->teamId = playerId;
+    spawn->tower->SetPlayerId(playerId);
+    spawn->team->SetTeam(playerId);
+    spawn->tower->team->SetTeam(playerId);
+    spawn->minionSpawner->team->SetTeam(playerId);
 
     for (int i = 0; i < 2; ++i)
     {
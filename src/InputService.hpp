@@ -3,6 +3,8 @@
 #include "PlayerEntity.hpp"
 #include "Scene/IEntityEvent.hpp"
 #include "Scene/Scene.hpp"
+#include "SimulationRecording.hpp"
+#include "SimulationStepEntity.hpp"
 
 struct CastleEntity;
 class PlayerNeuralNetworkService;
@@ -10,16 +12,23 @@ class PlayerNeuralNetworkService;
 struct InputService : ISceneService
 {
     void HandleInput();
+    void ApplyMouse(const RecordedMouse& mouse);
+    void ReplayInputs(uint64_t stepIndex);
+    uint64_t SimulationStepIndex();
     void Render(Renderer* renderer);
     void ReceiveEvent(const IEntityEvent& ev) override;
     void SpawnPlayer(CastleEntity* spawn, int playerId);
+    void RecordSceneMetrics();
 
     static MoveDirection GetInputDirection();
 
     EntityReference<PlayerEntity> activePlayer;
-    std::vector<PlayerEntity*> players;
     std::vector<CastleEntity*> spawns;
-	PlayerNeuralNetworkService* nnService;
+	PlayerNeuralNetworkService* nnService = nullptr;
+    std::unique_ptr<SimulationRecording> recording;     // Set by sim-record or sim-replay
 
     bool gameOver = false;
+
+    EntityReference<SimulationStepEntity> simulationStep = EntityReference<SimulationStepEntity>::Invalid();
+    int updatesSinceEntityCount = 0;
 };
@@ -11,6 +11,14 @@
 
 #include "MinionEntity.hpp"
 #include "TowerEntity.hpp"
+#include "Profiler.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamRegistryService.hpp"
+#include "MinionSystem.hpp"
+#include "FlowFieldService.hpp"
+#include "Tools/ConsoleVar.hpp"
+
+ConsoleVar<int> g_maxMinionsPerSpawner("minion-max-per-spawner", 0);
 
 void MinionSpawner::DoSerialize(EntitySerializer& serializer)
 {
@@ -20,10 +28,18 @@ void MinionSpawner::DoSerialize(EntitySerializer& serializer)
 void MinionSpawner::OnAdded()
 {
     team = AddComponent<TeamComponent>();
+
+    // Lane stress tests raise this well past the default
+    if (g_maxMinionsPerSpawner.Value() > 0)
+    {
+        maxMinions = g_maxMinionsPerSpawner.Value();
+    }
 }
 
 void MinionSpawner::FixedUpdate(float deltaTime)
 {
+    PROFILE_ZONE("MinionSpawner::FixedUpdate");
+
     spawnTimeout -= deltaTime;
 
     if (spawnTimeout <= 0 && minionCount < maxMinions)
@@ -46,7 +62,7 @@ void MinionSpawner::SpawnMinion()
 {
     auto minion = scene->CreateEntity<MinionEntity>(Center());
 
-    minion->team->teamId = team->teamId;
+    minion->team->SetTeam(team->teamId);
     minion->reach = reach;
     minion->AttackTimeoutLength = fireballTimeout;
     minion->engagementRadius = engagementRadius;
@@ -66,6 +82,7 @@ void MinionEntity::OnAdded()
     _healthBar = AddComponent<HealthBarComponent>();
 
     team = AddComponent<TeamComponent>();
+    AddComponent<SpatialIndexComponent>();
 
     _healthBar->offsetFromCenter = -Dimensions().YVector() / 2 - Vector2(0, 5);
     _pathFollower->speed = 50;
@@ -74,13 +91,12 @@ void MinionEntity::OnAdded()
 
 void MinionEntity::OnDestroyed()
 {
-    for (auto spawner : scene->GetEntitiesOfType<MinionSpawner>())
+    scene->GetService<MinionSystem>()->Remove(this);
+
+    scene->GetService<TeamRegistryService>()->ForEach<MinionSpawner>(team->teamId, [](MinionSpawner* spawner)
     {
-        if (spawner->team->teamId == team->teamId)
-        {
-            spawner->SendEvent(MinionDestroyedEvent());
-        }
-    }
+        spawner->SendEvent(MinionDestroyedEvent());
+    });
 }
 
 void MinionEntity::Start()
@@ -90,10 +106,17 @@ void MinionEntity::Start()
     auto towers = scene->GetEntitiesOfType<TowerEntity>();
     for (auto tower : towers) if (tower->team->teamId != team->teamId) _opponentTower = tower;
     ChangeState(MinionAiState::MoveToOpponentBase);
+
+    if (MinionSystem::Enabled())
+    {
+        scene->GetService<MinionSystem>()->Add(this);
+    }
 }
 
 void MinionEntity::Render(Renderer* renderer)
 {
+    PROFILE_ZONE("MinionEntity::Render");
+
     Color color = Color::Red();
 
     if (team->teamId == 0)
@@ -110,6 +133,13 @@ void MinionEntity::Render(Renderer* renderer)
 
 void MinionEntity::FixedUpdate(float deltaTime)
 {
+    if (_systemSlot >= 0)
+    {
+        return;
+    }
+
+    PROFILE_ZONE("MinionEntity::FixedUpdate");
+
     _attackTimeout -= deltaTime;
     OnUpdateState();
 }
@@ -138,6 +168,12 @@ void MinionEntity::ReceiveEvent(const IEntityEvent& ev)
         Destroy();
     }
 
+    // Minions run by the MinionSystem get their targets from the spatial hash instead
+    if (_systemSlot >= 0)
+    {
+        return;
+    }
+
     if (auto contactBegin = ev.Is<ContactBeginEvent>())
     {
         auto other = contactBegin->other.OwningEntity();
@@ -172,7 +208,15 @@ void MinionEntity::OnEnterState(MinionAiState stateEntered)
     {
         TowerEntity* towerEntity;
         CastleEntity* castleEntity;
-        if (_opponentTower.TryGetValue(towerEntity))
+
+        _usingFlowField = false;
+        if (FlowFieldService::Enabled())
+        {
+            _pathFollower->Stop(true);
+            _usingFlowField = true;
+            SteerAlongFlowField();
+        }
+        else if (_opponentTower.TryGetValue(towerEntity))
         {
             _pathFollower->SetTarget(towerEntity->Center() - Vector2(0, 20));
         }
@@ -235,6 +279,10 @@ void MinionEntity::OnUpdateState()
         {
             ChangeState(MinionAiState::AttackTarget);
         }
+        else
+        {
+            SteerAlongFlowField();
+        }
 
         break;
     }
@@ -301,8 +349,39 @@ void MinionEntity::FollowTarget(Entity* followTarget)
     _pathFollower->FollowEntity(followTarget, 128.0f);
 }
 
+void MinionEntity::SteerAlongFlowField()
+{
+    if (!_usingFlowField)
+    {
+        return;
+    }
+
+    Entity* destination = _opponentTower.GetValueOrNull();
+    if (destination == nullptr)
+    {
+        destination = _opponentBase.GetValueOrNull();
+    }
+
+    Vector2 direction;
+    if (destination != nullptr
+        && scene->GetService<FlowFieldService>()->TryGetDirection(team->teamId, destination, Center(), direction))
+    {
+        _rb->SetVelocity(direction * _pathFollower->speed);
+        return;
+    }
+
+    // Off the field, such as when stuck inside an obstacle, so the path follower takes over as before
+    _usingFlowField = false;
+    if (destination != nullptr)
+    {
+        _pathFollower->SetTarget(destination->Center());
+    }
+}
+
 Entity* MinionEntity::FindTargetOrNull()
 {
+    PROFILE_ZONE("MinionEntity::FindTargetOrNull");
+
     // These are kept in order by priority
     EntityDistanceByType closestTargetByEntityId[] = { CastleEntity::Type, MinionEntity::Type, PlayerEntity::Type, TowerEntity::Type };
 
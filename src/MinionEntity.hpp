@@ -18,7 +18,7 @@ DEFINE_ENTITY(MinionSpawner, "minion-spawner")
     void ReceiveEvent(const IEntityEvent & ev) override;
     void SpawnMinion();
 
-    const int maxMinions = 6;
+    int maxMinions = 6;     // Overridden by minion-max-per-spawner when that's set
     int minionCount = 0;
 
     float spawnTimeout = 0;//2.0f;
@@ -70,6 +70,10 @@ public:
     Entity* FindTargetOrNull();
 
 private:
+    // Set while the MinionSystem updates this minion
+    friend class MinionSystem;
+    int _systemSlot = -1;
+
     void OnEnterState(MinionAiState stateEntered);
     void OnUpdateState();
 
@@ -78,6 +82,7 @@ private:
     void MeleeAttack(Entity * attackTarget);
     void ResetTimeouts();
     void FollowTarget(Entity * followTarget);
+    void SteerAlongFlowField();
 
     float _attackTimeout = 0.75;
 
@@ -90,4 +95,5 @@ private:
     EntityReference<CastleEntity> _opponentBase = EntityReference<CastleEntity>::Invalid();
     FixedSizeVector<EntityReference<Entity>, 16> _targets;
     b2Fixture* _engagementCircle;
+    bool _usingFlowField = false;
 };
\ No newline at end of file
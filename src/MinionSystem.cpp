@@ -0,0 +1,217 @@
+#include "MinionSystem.hpp"
+
+#include "CastleEntity.hpp"
+#include "PlayerEntity.hpp"
+#include "TowerEntity.hpp"
+#include "HealthBarComponent.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamComponent.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "Profiler.hpp"
+
+ConsoleVar<bool> g_minionSystem("minion-system", false);
+
+bool MinionSystem::Enabled()
+{
+    return g_minionSystem.Value();
+}
+
+void MinionSystem::Add(MinionEntity* minion)
+{
+    minion->_systemSlot = static_cast<int>(minions.size());
+
+    minions.push_back(minion);
+    states.push_back(static_cast<uint8_t>(minion->state));
+    teams.push_back(minion->team->teamId);
+    attackTimeouts.push_back(minion->_attackTimeout);
+    attackTimeoutLengths.push_back(minion->AttackTimeoutLength);
+    reaches.push_back(minion->reach);
+    engagementRadii.push_back(minion->engagementRadius);
+}
+
+void MinionSystem::Remove(MinionEntity* minion)
+{
+    int slot = minion->_systemSlot;
+    if (slot < 0)
+    {
+        return;
+    }
+
+    minion->_systemSlot = -1;
+
+    // Minions killed by an attack during the update are only compacted away once it's done
+    if (updating)
+    {
+        minions[slot] = nullptr;
+        return;
+    }
+
+    RemoveSlot(slot);
+}
+
+void MinionSystem::RemoveSlot(int slot)
+{
+    // Moves the last minion into the freed slot
+    int last = static_cast<int>(minions.size()) - 1;
+    minions[slot] = minions[last];
+    states[slot] = states[last];
+    teams[slot] = teams[last];
+    attackTimeouts[slot] = attackTimeouts[last];
+    attackTimeoutLengths[slot] = attackTimeoutLengths[last];
+    reaches[slot] = reaches[last];
+    engagementRadii[slot] = engagementRadii[last];
+    if (minions[slot] != nullptr)
+    {
+        minions[slot]->_systemSlot = slot;
+    }
+
+    minions.pop_back();
+    states.pop_back();
+    teams.pop_back();
+    attackTimeouts.pop_back();
+    attackTimeoutLengths.pop_back();
+    reaches.pop_back();
+    engagementRadii.pop_back();
+}
+
+void MinionSystem::FixedUpdate(float deltaTime)
+{
+    if (!minions.empty())
+    {
+        updating = true;
+        Update(deltaTime);
+        updating = false;
+
+        // Descending, so every slot moved into a freed one has already been checked
+        for (int slot = static_cast<int>(minions.size()) - 1; slot >= 0; --slot)
+        {
+            if (minions[slot] == nullptr)
+            {
+                RemoveSlot(slot);
+            }
+        }
+    }
+}
+
+void MinionSystem::Update(float deltaTime)
+{
+    PROFILE_ZONE("MinionSystem::Update");
+
+    int count = static_cast<int>(minions.size());
+
+    positionX.resize(count);
+    positionY.resize(count);
+    targets.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Vector2 center = minions[i]->Center();
+        positionX[i] = center.x;
+        positionY[i] = center.y;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        attackTimeouts[i] -= deltaTime;
+    }
+
+    // Only minions that are moving or attacking look for targets
+    {
+        PROFILE_ZONE("MinionSystem::FindTargets");
+
+        for (int i = 0; i < count; ++i)
+        {
+            auto state = static_cast<MinionAiState>(states[i]);
+            targets[i] = state == MinionAiState::MoveToOpponentBase || state == MinionAiState::AttackTarget
+                ? FindTarget(i, Vector2(positionX[i], positionY[i]))
+                : nullptr;
+        }
+    }
+
+    // Transitions and attacks can create and destroy entities, so they're applied after every target has been chosen.
+    // Minions spawned meanwhile are appended past count and wait for the next step.
+    for (int i = 0; i < count; ++i)
+    {
+        MinionEntity* minion = minions[i];
+        Entity* target = targets[i];
+
+        if (minion == nullptr)
+        {
+            continue;
+        }
+
+        if (target != nullptr && target->isDestroyed)
+        {
+            target = nullptr;
+        }
+
+        switch (static_cast<MinionAiState>(states[i]))
+        {
+        case MinionAiState::DoNothing:
+            if (minion->_opponentBase.IsValid() || minion->_opponentTower.IsValid())
+            {
+                SetState(i, MinionAiState::MoveToOpponentBase);
+            }
+
+            break;
+        case MinionAiState::MoveToOpponentBase:
+            if (target != nullptr)
+            {
+                SetState(i, MinionAiState::AttackTarget);
+            }
+            else
+            {
+                minion->SteerAlongFlowField();
+            }
+
+            break;
+        case MinionAiState::AttackTarget:
+            if (target == nullptr)
+            {
+                SetState(i, MinionAiState::MoveToOpponentBase);
+                break;
+            }
+
+            minion->FollowTarget(target);
+
+            if (attackTimeouts[i] <= 0)
+            {
+                attackTimeouts[i] = attackTimeoutLengths[i];
+
+                float dx = target->Center().x - positionX[i];
+                float dy = target->Center().y - positionY[i];
+                if (dx * dx + dy * dy <= reaches[i] * reaches[i])
+                {
+                    target->GetComponent<HealthBarComponent>()->TakeDamage(5.0, minion);
+                }
+            }
+
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+Entity* MinionSystem::FindTarget(int slot, Vector2 position)
+{
+    auto spatialHash = scene->GetService<SpatialHashService>();
+    TeamFilter enemies = TeamFilter::EnemiesOf(teams[slot]);
+    float engagementRadius = engagementRadii[slot];
+
+    // Same priority order as MinionEntity::FindTargetOrNull, the closest enemy of the first type with one in range wins
+    if (auto castle = std::get<0>(spatialHash->FindNearest<CastleEntity>(position, enemies, engagementRadius))) return castle;
+    if (auto minion = std::get<0>(spatialHash->FindNearest<MinionEntity>(position, enemies, engagementRadius))) return minion;
+    if (auto player = std::get<0>(spatialHash->FindNearest<PlayerEntity>(position, enemies, engagementRadius))) return player;
+    if (auto tower = std::get<0>(spatialHash->FindNearest<TowerEntity>(position, enemies, engagementRadius))) return tower;
+
+    return nullptr;
+}
+
+void MinionSystem::SetState(int slot, MinionAiState newState)
+{
+    states[slot] = static_cast<uint8_t>(newState);
+
+    // The entity's own transition runs the enter actions, like setting the path to the opponent's base
+    minions[slot]->ChangeState(newState);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Scene/Scene.hpp"
+#include "MinionEntity.hpp"
+
+// Runs the minion AI for every minion in batched passes over parallel arrays instead of each minion's FixedUpdate.
+// Opt-in with minion-system; minions spawned while it's off keep updating themselves. Targets come from the spatial
+// hash rather than each minion's engagement-circle contacts, with the same priority order and engagement radius.
+class MinionSystem : public ISceneService
+{
+public:
+    static bool Enabled();
+
+    void Add(MinionEntity* minion);
+    void Remove(MinionEntity* minion);
+
+    // Stepped by the SimulationStepEntity in place of each minion's FixedUpdate
+    void FixedUpdate(float deltaTime);
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+private:
+    void RemoveSlot(int slot);
+    void Update(float deltaTime);
+    Entity* FindTarget(int slot, Vector2 position);
+    void SetState(int slot, MinionAiState newState);
+
+    std::vector<MinionEntity*> minions;
+    std::vector<uint8_t> states;
+    std::vector<int> teams;
+    std::vector<float> attackTimeouts;
+    std::vector<float> attackTimeoutLengths;
+    std::vector<float> reaches;
+    std::vector<float> engagementRadii;
+
+    // Rebuilt every step
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<Entity*> targets;
+
+    bool updating = false;
+};
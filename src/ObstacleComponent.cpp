@@ -1,5 +1,6 @@
 #include "ObstacleComponent.hpp"
 #include "Physics/PathFinding.hpp"
+#include "FlowFieldService.hpp"
 
 void ObstacleComponent::OnAdded()
 {
@@ -7,9 +8,11 @@ void ObstacleComponent::OnAdded()
         GetScene()->isometricSettings.WorldToTile(owner->Bounds().BottomRight()) - GetScene()->isometricSettings.WorldToTile(owner->Bounds().TopLeft()));
     GetScene()->GetService<PathFinderService>()->AddObstacle(adjusted);
     bounds = adjusted;
+    GetScene()->GetService<FlowFieldService>()->ObstaclesChanged();
 }
 
 void ObstacleComponent::OnRemoved()
 {
     GetScene()->GetService<PathFinderService>()->RemoveObstacle(bounds);
+    GetScene()->GetService<FlowFieldService>()->ObstaclesChanged();
 }
\ No newline at end of file
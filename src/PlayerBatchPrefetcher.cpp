@@ -0,0 +1,143 @@
+#include "PlayerBatchPrefetcher.hpp"
+#include "Profiler.hpp"
+
+#include <chrono>
+
+// Minimal view of a batch of single-sample sequences, so the packer can read the drawn samples directly
+struct DrawnSampleRows
+{
+    struct Row
+    {
+        const PlayerNetwork::SampleType& operator[](int col) const { return sample; }
+        const PlayerNetwork::SampleType& sample;
+    };
+
+    int Rows() const { return static_cast<int>(samples.size()); }
+    int Cols() const { return 1; }
+    Row operator[](int row) const { return { samples[row] }; }
+
+    const std::vector<PlayerNetwork::SampleType>& samples;
+};
+
+PlayerBatchPrefetcher::PlayerBatchPrefetcher(DrawBatchFn drawBatch, int batchSize, int loaderCount, int queueDepth, Metric* queueDepthMetric, Metric* stallMetric)
+    : drawBatch(std::move(drawBatch)),
+    batchSize(batchSize),
+    queueDepth(std::max(queueDepth, 1)),
+    queueDepthMetric(queueDepthMetric),
+    stallMetric(stallMetric)
+{
+    for (int i = 0; i < loaderCount; ++i)
+    {
+        loaders.emplace_back([=] { RunLoader(i); });
+    }
+}
+
+PlayerBatchPrefetcher::~PlayerBatchPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+
+    batchTaken.notify_all();
+    for (auto& loader : loaders)
+    {
+        loader.join();
+    }
+}
+
+std::unique_ptr<PreparedTrainingBatch> PlayerBatchPrefetcher::TryTake(torch::Device trainingDevice)
+{
+    std::unique_ptr<PreparedTrainingBatch> batch;
+    int depth;
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (device != trainingDevice)
+        {
+            device = trainingDevice;
+            readyBatches.clear();
+        }
+
+        depth = static_cast<int>(readyBatches.size());
+        if (!readyBatches.empty())
+        {
+            batch = std::move(readyBatches.front());
+            readyBatches.pop_front();
+        }
+    }
+
+    batchTaken.notify_one();
+
+    queueDepthMetric->Add(static_cast<float>(depth));
+    stallMetric->Add(batch == nullptr ? 1.0f : 0.0f);
+
+    return batch;
+}
+
+void PlayerBatchPrefetcher::RunLoader(int loaderIndex)
+{
+    std::vector<SampleType> samples(batchSize);
+
+    while (true)
+    {
+        torch::Device loaderDevice = torch::Device(torch::kCPU);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            batchTaken.wait(lock, [=] { return stopping || static_cast<int>(readyBatches.size()) < queueDepth; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            loaderDevice = device;
+        }
+
+        if (!drawBatch(samples.data(), batchSize, loaderIndex))
+        {
+            // Nothing to train on yet
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        auto batch = Prepare(samples, loaderDevice);
+
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+
+            // Another loader may have filled the queue meanwhile, or the device changed
+            if (static_cast<int>(readyBatches.size()) < queueDepth && device == loaderDevice)
+            {
+                readyBatches.push_back(std::move(batch));
+            }
+        }
+    }
+}
+
+std::unique_ptr<PreparedTrainingBatch> PlayerBatchPrefetcher::Prepare(const std::vector<SampleType>& samples, torch::Device loaderDevice)
+{
+    PROFILE_ZONE("PlayerBatchPrefetcher::Prepare");
+
+    // A fresh packer per batch, so each queued batch owns its staging tensors
+    PlayerBatchPacker packer;
+    packer.SetPinMemory(loaderDevice.is_cuda());
+
+    DrawnSampleRows rows { samples };
+    packer.PackObservations(rows, [](const SampleType& sample) -> const Observation& { return sample.input; });
+    packer.PackLabels(rows);
+
+    bool nonBlocking = loaderDevice.is_cuda();
+
+    auto batch = std::make_unique<PreparedTrainingBatch>();
+    batch->device = loaderDevice;
+    batch->players = packer.players.to(loaderDevice, nonBlocking);
+    batch->minions = packer.minions.to(loaderDevice, nonBlocking);
+    batch->buildings = packer.buildings.to(loaderDevice, nonBlocking);
+    batch->actionLabels = packer.actionLabels.to(loaderDevice, nonBlocking).squeeze();
+    batch->moveLabels = packer.moveLabels.to(loaderDevice, nonBlocking).squeeze();
+    batch->entityLabels = packer.entityLabels.to(loaderDevice, nonBlocking).squeeze();
+
+    return batch;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GameML.hpp"
+
+// A training batch that has already been packed and copied to the training device
+struct PreparedTrainingBatch
+{
+    torch::Device device = torch::Device(torch::kCPU);
+    torch::Tensor players;
+    torch::Tensor minions;
+    torch::Tensor buildings;
+    torch::Tensor actionLabels;
+    torch::Tensor moveLabels;
+    torch::Tensor entityLabels;
+};
+
+// Loader threads that draw, pack and upload the next few training batches while the current one trains, keeping them
+// in a bounded queue. Taking a batch never waits: when the queue is empty the caller packs its own batch instead.
+class PlayerBatchPrefetcher
+{
+public:
+    using SampleType = PlayerNetwork::SampleType;
+    // Called on loader threads, each with its own loaderIndex
+    using DrawBatchFn = std::function<bool(SampleType* outBatch, int batchSize, int loaderIndex)>;
+
+    PlayerBatchPrefetcher(DrawBatchFn drawBatch, int batchSize, int loaderCount, int queueDepth, Metric* queueDepthMetric, Metric* stallMetric);
+    ~PlayerBatchPrefetcher();
+
+    // Returns the next batch prepared for the given device, or null if none is ready. Batches prepared for another
+    // device are dropped, and the loaders switch to the new one.
+    std::unique_ptr<PreparedTrainingBatch> TryTake(torch::Device device);
+
+private:
+    void RunLoader(int loaderIndex);
+    std::unique_ptr<PreparedTrainingBatch> Prepare(const std::vector<SampleType>& samples, torch::Device device);
+
+    DrawBatchFn drawBatch;
+    int batchSize;
+    int queueDepth;
+    Metric* queueDepthMetric;
+    Metric* stallMetric;
+
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable batchTaken;
+    std::deque<std::unique_ptr<PreparedTrainingBatch>> readyBatches;
+    torch::Device device = torch::Device(torch::kCPU);
+    bool stopping = false;
+};
@@ -0,0 +1,138 @@
+#include "PlayerDecisionPipeline.hpp"
+
+PlayerDecisionPipeline::PlayerDecisionPipeline(PlayerNetwork* network)
+    : network(network)
+{
+    worker = std::thread([=] { RunWorker(); });
+}
+
+PlayerDecisionPipeline::~PlayerDecisionPipeline()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+
+    batchSubmitted.notify_all();
+    worker.join();
+}
+
+std::unique_ptr<PlayerDecisionPipeline::Batch> PlayerDecisionPipeline::AcquireBatch()
+{
+    std::unique_ptr<Batch> batch;
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!freeBatches.empty())
+        {
+            batch = std::move(freeBatches.back());
+            freeBatches.pop_back();
+        }
+    }
+
+    if (batch == nullptr)
+    {
+        batch = std::make_unique<Batch>();
+    }
+
+    batch->entities.clear();
+    batch->inputs.clear();
+    batch->outputs.clear();
+    batch->done = false;
+
+    return batch;
+}
+
+void PlayerDecisionPipeline::Submit(std::unique_ptr<Batch> batch)
+{
+    batch->outputs.resize(batch->inputs.size());
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        inFlight.push_back(std::move(batch));
+    }
+
+    batchSubmitted.notify_one();
+}
+
+std::unique_ptr<PlayerDecisionPipeline::Batch> PlayerDecisionPipeline::TakeDueBatch(uint64_t snapshotTick)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (inFlight.empty() || inFlight.front()->snapshotTick > snapshotTick)
+    {
+        return nullptr;
+    }
+
+    // The decisions are due now, so if inference is running behind the tick has to wait for it
+    batchCompleted.wait(lock, [=] { return inFlight.front()->done; });
+
+    auto batch = std::move(inFlight.front());
+    inFlight.pop_front();
+
+    return batch;
+}
+
+void PlayerDecisionPipeline::Recycle(std::unique_ptr<Batch> batch)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    freeBatches.push_back(std::move(batch));
+}
+
+int PlayerDecisionPipeline::BatchesInFlight()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return static_cast<int>(inFlight.size());
+}
+
+void PlayerDecisionPipeline::RunWorker()
+{
+    while (true)
+    {
+        Batch* batch = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            batchSubmitted.wait(lock, [=]
+            {
+                if (stopping) return true;
+                for (auto& pending : inFlight) if (!pending->done) return true;
+                return false;
+            });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            // Batches are only removed from the front once done, so the first unfinished one stays put while we work
+            for (auto& pending : inFlight)
+            {
+                if (!pending->done)
+                {
+                    batch = pending.get();
+                    break;
+                }
+            }
+        }
+
+        try
+        {
+            network->DecideBatch(batch->inputs, batch->outputs);
+        }
+        catch (const std::exception&)
+        {
+            // DecideBatch has already logged the error, leave the players doing what they were doing
+            for (auto& output : batch->outputs)
+            {
+                output.actionIndex = 0;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            batch->done = true;
+        }
+
+        batchCompleted.notify_all();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PlayerEntity.hpp"
+
+// Runs player decision batches on a worker thread, so that inference for a snapshot taken at the end of one tick
+// overlaps with simulating the next ones. Batches complete in the order they were submitted.
+class PlayerDecisionPipeline
+{
+public:
+    struct Batch
+    {
+        uint64_t snapshotTick = 0;
+        std::vector<EntityReference<PlayerEntity>> entities;
+        std::vector<Observation> inputs;
+        std::vector<TrainingLabel> outputs;
+        bool done = false;
+    };
+
+    explicit PlayerDecisionPipeline(PlayerNetwork* network);
+    ~PlayerDecisionPipeline();
+
+    // Returns an empty batch, reusing the buffers of one that was recycled
+    std::unique_ptr<Batch> AcquireBatch();
+    void Submit(std::unique_ptr<Batch> batch);
+
+    // Returns the oldest batch if it was snapshotted at or before the given tick, waiting for the worker to finish it
+    std::unique_ptr<Batch> TakeDueBatch(uint64_t snapshotTick);
+    void Recycle(std::unique_ptr<Batch> batch);
+
+    int BatchesInFlight();
+
+private:
+    void RunWorker();
+
+    PlayerNetwork* network;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable batchSubmitted;
+    std::condition_variable batchCompleted;
+    std::deque<std::unique_ptr<Batch>> inFlight;
+    std::vector<std::unique_ptr<Batch>> freeBatches;
+    bool stopping = false;
+};
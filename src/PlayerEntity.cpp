@@ -8,6 +8,11 @@
 
 #include "CastleEntity.hpp"
 #include "FireballEntity.hpp"
+#include "TopKSelector.hpp"
+#include "SkipVisuals.hpp"
+#include "Profiler.hpp"
+#include "TeamRegistryService.hpp"
+#include "RespawnService.hpp"
 
 Vector2 MoveDirectionToVector2(MoveDirection direction)
 {
@@ -56,11 +61,14 @@ MoveDirection GetClosestMoveDirection(Vector2 v)
 
 void PlayerEntity::OnAdded()
 {
-    auto light = AddComponent<LightComponent<PointLight>>();
-    light->position = Center();
-    light->color = Color(255, 255, 255, 255);
-    light->maxDistance = 400;
-    light->intensity = 0.6;
+    if (!g_skipVisuals)
+    {
+        auto light = AddComponent<LightComponent<PointLight>>();
+        light->position = Center();
+        light->color = Color(255, 255, 255, 255);
+        light->maxDistance = 400;
+        light->intensity = 0.6;
+    }
 
     health = AddComponent<HealthBarComponent>();
     health->offsetFromCenter = Vector2(0, -20);
@@ -69,6 +77,7 @@ void PlayerEntity::OnAdded()
     pathFollower = AddComponent<PathFollowerComponent>(rigidBody);
 
     team = AddComponent<TeamComponent>();
+    AddComponent<SpatialIndexComponent>();
 
     SetDimensions({ 30, 30 });
     auto box = rigidBody->CreateBoxCollider(Dimensions());
@@ -76,7 +85,6 @@ void PlayerEntity::OnAdded()
     box->SetDensity(1);
     box->SetFriction(0);
 
-    scene->GetService<InputService>()->players.push_back(this);
     //gridSensor = AddComponent<GridSensorComponent<40, 40>>(Vector2(16, 16));
 }
 
@@ -104,11 +112,16 @@ void PlayerEntity::Die(const OutOfHealthEvent* outOfHealth)
 
 void PlayerEntity::OnDestroyed()
 {
-    RemoveFromVector(scene->GetService<InputService>()->players, this);
+    scene->GetService<TeamRegistryService>()->ForEach<CastleEntity>(team->teamId, [](CastleEntity* castle)
+    {
+        castle->SendEvent(PlayerDestroyedEvent());
+    });
 }
 
 void PlayerEntity::Render(Renderer* renderer)
 {
+    PROFILE_ZONE("PlayerEntity::Render");
+
     auto position = Center();
 
     // Render player
@@ -128,6 +141,8 @@ void PlayerEntity::Render(Renderer* renderer)
 
 void PlayerEntity::FixedUpdate(float deltaTime)
 {
+    PROFILE_ZONE("PlayerEntity::FixedUpdate");
+
     attackCoolDown -= deltaTime;
 
     if (state == PlayerState::Attacking)
@@ -183,77 +198,77 @@ void PlayerEntity::SetMoveDirection(Vector2 direction)
 
 void PlayerEntity::MoveTo(Vector2 position)
 {
+    PROFILE_ZONE("PlayerEntity::MoveTo (pathfinding)");
+
     pathFollower->SetTarget(position);
     lastMoveVector = position;
     state = PlayerState::Moving;
 }
 
-void PlayerEntity::GetObservation(Observation& input)
+// Slot selection score: squared distance, scaled so that higher priority entities count as closer
+static float SelectionScore(Vector2 offset, float priority)
 {
-    input.players.clear();
-    input.minions.clear();
-    input.buildings.clear();
+    return offset.Dot(offset) / (priority * priority);
+}
 
-    for (auto player : scene->GetEntitiesOfType<PlayerEntity>()) 
+static float HealthFraction(Entity* entity)
+{
+    HealthBarComponent* health;
+    if (entity->TryGetComponent(health))
     {
-        PlayerObservation playerObs;
-        playerObs.position = (player->Center() - Center()) / 4160.0f;
-        playerObs.velocity = player->rigidBody->GetVelocity() / 200.0f;
-        playerObs.health = player->health->health / player->health->maxHealth;
-
-        input.players.push_back(playerObs);
+        return health->health / health->maxHealth;
     }
 
-    for (auto minion : scene->GetEntitiesOfType<MinionEntity>())
-    {
-        MinionObservation minionObs;
-        minionObs.position = (minion->Center() - Center()) / 4160.0f;
+    return 1;
+}
 
-        RigidBodyComponent* rb;
-        if (minion->TryGetComponent(rb))
-        {
-            minionObs.velocity = rb->GetVelocity() / 200.0f;
-        }
+void PlayerEntity::GetObservation(Observation& input)
+{
+    PROFILE_ZONE("PlayerEntity::GetObservation");
 
-        HealthBarComponent* health;
-        if (minion->TryGetComponent(health))
-        {
-            minionObs.health = health->health / health->maxHealth;
-        }
-        
-        input.minions.push_back(minionObs);
-    }
+    input.players.Clear();
+    input.minions.Clear();
+    input.buildings.Clear();
 
-    for (auto tower : scene->GetEntitiesOfType<TowerEntity>())
-    {
-        BuildingObservation buildingObs;
-        buildingObs.position = (tower->Center() - Center()) / 4160.0f;
-        
-        HealthBarComponent* health;
-        if (tower->TryGetComponent(health))
-        {
-            buildingObs.health = health->health / health->maxHealth;
-        }
+    // Only the nearest entities of each kind get a slot. Features are only gathered for the ones selected.
+    TopKSelector<PlayerEntity*, MaxObservedPlayers> nearestPlayers;
+    TopKSelector<MinionEntity*, MaxObservedMinions> nearestMinions;
+    TopKSelector<Entity*, MaxObservedBuildings> nearestBuildings;
 
-        input.buildings.push_back(buildingObs);
+    // SelectionScore of a unit offset is the factor the spatial hash scales squared distances by
+    auto spatialHash = scene->GetService<SpatialHashService>();
+    spatialHash->FindKNearest<PlayerEntity>(Center(), TeamFilter::Any(), nearestPlayers, SelectionScore(Vector2(1, 0), SensorPriority::Player));
+    spatialHash->FindKNearest<MinionEntity>(Center(), TeamFilter::Any(), nearestMinions, SelectionScore(Vector2(1, 0), SensorPriority::Minion));
+    spatialHash->FindKNearest<TowerEntity>(Center(), TeamFilter::Any(), nearestBuildings, SelectionScore(Vector2(1, 0), SensorPriority::Tower));
+    spatialHash->FindKNearest<CastleEntity>(Center(), TeamFilter::Any(), nearestBuildings, SelectionScore(Vector2(1, 0), SensorPriority::Castle));
+
+    for (auto entry = nearestPlayers.SortAndBegin(); entry != nearestPlayers.End(); ++entry)
+    {
+        auto player = entry->candidate;
+        input.players.TryAdd(
+            (player->Center() - Center()) / 4160.0f,
+            player->rigidBody->GetVelocity() / 200.0f,
+            player->health->health / player->health->maxHealth);
     }
 
-    for (auto castle : scene->GetEntitiesOfType<CastleEntity>())
+    for (auto entry = nearestMinions.SortAndBegin(); entry != nearestMinions.End(); ++entry)
     {
-        BuildingObservation buildingObs;
-        buildingObs.position = (castle->Center() - Center()) / 4160.0f;
+        auto minion = entry->candidate;
+        Vector2 velocity;
 
-        HealthBarComponent* health;
-        if (castle->TryGetComponent(health))
-        {
-            buildingObs.health = health->health / health->maxHealth;
-        }
-        else
+        RigidBodyComponent* rb;
+        if (minion->TryGetComponent(rb))
         {
-            buildingObs.health = 1;
+            velocity = rb->GetVelocity() / 200.0f;
         }
 
-        input.buildings.push_back(buildingObs);
+        input.minions.TryAdd((minion->Center() - Center()) / 4160.0f, velocity, HealthFraction(minion));
+    }
+
+    for (auto entry = nearestBuildings.SortAndBegin(); entry != nearestBuildings.End(); ++entry)
+    {
+        auto building = entry->candidate;
+        input.buildings.TryAdd((building->Center() - Center()) / 4160.0f, HealthFraction(building));
     }
 }
 
@@ -8,6 +8,7 @@
 #include "Scene/IEntityEvent.hpp"
 #include "HealthBarComponent.hpp"
 #include "TeamComponent.hpp"
+#include "SpatialHashService.hpp"
 
 enum class PlayerState
 {
@@ -46,24 +47,7 @@ DEFINE_ENTITY(PlayerEntity, "player")
     template<typename TEntity>
     std::tuple<TEntity*, float> NearestEntityOfType()
     {
-        TEntity* nearest = nullptr;
-        float minDistance;
-        for (auto entity : scene->GetEntitiesOfType<TEntity>())
-        {
-            float distance = (entity->Center() - Center()).Length();
-
-            if (nearest == nullptr || distance < minDistance)
-            {
-                TeamComponent* otherTeam;
-                if (entity->TryGetComponent<TeamComponent>(otherTeam) && otherTeam->teamId != team->teamId)
-                {
-                    nearest = entity;
-                    minDistance = distance;
-                }
-            }
-        }
-
-        return std::make_tuple(nearest, minDistance);
+        return scene->GetService<SpatialHashService>()->FindNearest<TEntity>(Center(), TeamFilter::EnemiesOf(team->teamId));
     }
 
     RigidBodyComponent* rigidBody;
@@ -0,0 +1,27 @@
+// Compiled with AVX2 and FMA enabled. Only called after GetDenseApply has checked the CPU supports them, so nothing
+// but intrinsics may be included here.
+#include "PlayerInferenceSimd.hpp"
+
+#include <immintrin.h>
+
+template<int In, int PaddedOut>
+void DenseApplyAvx2(const float* input, const float* weights, const float* bias, bool relu, float* output)
+{
+    static_assert(PaddedOut % 8 == 0, "Outputs must fill whole AVX2 registers");
+
+    for (int o = 0; o < PaddedOut; o += 8)
+    {
+        __m256 sum = _mm256_load_ps(bias + o);
+        for (int i = 0; i < In; ++i)
+        {
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(input[i]), _mm256_load_ps(weights + i * PaddedOut + o), sum);
+        }
+
+        if (relu) sum = _mm256_max_ps(sum, _mm256_setzero_ps());
+        _mm256_storeu_ps(output + o, sum);
+    }
+}
+
+#define INSTANTIATE_DENSE_APPLY(In, PaddedOut) \
+    template void DenseApplyAvx2<In, PaddedOut>(const float*, const float*, const float*, bool, float*);
+PLAYER_KERNEL_DENSE_SHAPES(INSTANTIATE_DENSE_APPLY)
@@ -0,0 +1,27 @@
+// Compiled with AVX-512 enabled. Only called after GetDenseApply has checked the CPU supports it, so nothing but
+// intrinsics may be included here.
+#include "PlayerInferenceSimd.hpp"
+
+#include <immintrin.h>
+
+template<int In, int PaddedOut>
+void DenseApplyAvx512(const float* input, const float* weights, const float* bias, bool relu, float* output)
+{
+    static_assert(PaddedOut % 16 == 0, "Outputs must fill whole AVX-512 registers");
+
+    for (int o = 0; o < PaddedOut; o += 16)
+    {
+        __m512 sum = _mm512_load_ps(bias + o);
+        for (int i = 0; i < In; ++i)
+        {
+            sum = _mm512_fmadd_ps(_mm512_set1_ps(input[i]), _mm512_load_ps(weights + i * PaddedOut + o), sum);
+        }
+
+        if (relu) sum = _mm512_max_ps(sum, _mm512_setzero_ps());
+        _mm512_storeu_ps(output + o, sum);
+    }
+}
+
+#define INSTANTIATE_DENSE_APPLY(In, PaddedOut) \
+    template void DenseApplyAvx512<In, PaddedOut>(const float*, const float*, const float*, bool, float*);
+PLAYER_KERNEL_DENSE_SHAPES(INSTANTIATE_DENSE_APPLY)
@@ -0,0 +1,561 @@
+#include "PlayerInferenceKernel.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "PlayerInferenceSimd.hpp"
+
+template<int In, int Out>
+void DenseLayer<In, Out>::Export(torch::nn::Linear& layer)
+{
+    auto weight = layer->weight.detach().to(torch::kCPU).contiguous();
+    auto biasTensor = layer->bias.detach().to(torch::kCPU).contiguous();
+    auto weightData = weight.accessor<float, 2>();
+    auto biasData = biasTensor.accessor<float, 1>();
+
+    // Padding lanes stay zero, which keeps them zero through every layer
+    std::memset(weights, 0, sizeof(weights));
+    std::memset(bias, 0, sizeof(bias));
+
+    for (int o = 0; o < Out; ++o)
+    {
+        for (int i = 0; i < In; ++i)
+        {
+            weights[i][o] = weightData[o][i];
+        }
+
+        bias[o] = biasData[o];
+    }
+}
+
+template<int In, int Out>
+template<bool Relu>
+void DenseLayer<In, Out>::Apply(const float* input, float* output) const
+{
+    static const DenseApplyFunction<In, paddedOutputs> apply = GetDenseApply<In, paddedOutputs>();
+    apply(input, &weights[0][0], bias, Relu, output);
+}
+
+template<int Features>
+void EmbeddingKernel<Features>::Export(torch::nn::Linear& layer1Source, torch::nn::Linear& layer2Source, torch::nn::Linear& layer3Source)
+{
+    layer1.Export(layer1Source);
+    layer2.Export(layer2Source);
+    layer3.Export(layer3Source);
+
+    float zeros[Features] = { };
+    alignas(64) float hidden1[decltype(layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(layer2)::paddedOutputs];
+
+    layer1.template Apply<true>(zeros, hidden1);
+    layer2.template Apply<true>(hidden1, hidden2);
+    layer3.template Apply<false>(hidden2, emptySlotEmbedding);
+}
+
+template<int Features>
+void EmbeddingKernel<Features>::Apply(const float* slots, int count, int capacity, float* output) const
+{
+    alignas(64) float hidden1[decltype(layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(layer2)::paddedOutputs];
+    alignas(64) float embedding[decltype(layer3)::paddedOutputs];
+
+    for (int i = 0; i < embeddingSize; ++i)
+    {
+        output[i] = 0;
+    }
+
+    for (int slot = 0; slot < count; ++slot)
+    {
+        layer1.template Apply<true>(slots + slot * Features, hidden1);
+        layer2.template Apply<true>(hidden1, hidden2);
+        layer3.template Apply<false>(hidden2, embedding);
+
+        for (int i = 0; i < embeddingSize; ++i)
+        {
+            output[i] += embedding[i];
+        }
+    }
+
+    float emptySlots = static_cast<float>(capacity - count);
+    for (int i = 0; i < embeddingSize; ++i)
+    {
+        output[i] += emptySlots * emptySlotEmbedding[i];
+    }
+}
+
+template<int Outputs>
+void HeadKernel<Outputs>::Export(torch::nn::Linear& layer1Source, torch::nn::Linear& layer2Source, torch::nn::Linear& layer3Source)
+{
+    layer1.Export(layer1Source);
+    layer2.Export(layer2Source);
+    layer3.Export(layer3Source);
+}
+
+template<int Outputs>
+void HeadKernel<Outputs>::Apply(const float* postRep, float* output) const
+{
+    alignas(64) float hidden1[decltype(layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(layer2)::paddedOutputs];
+    alignas(64) float result[decltype(layer3)::paddedOutputs];
+
+    layer1.template Apply<true>(postRep, hidden1);
+    layer2.template Apply<true>(hidden1, hidden2);
+    layer3.template Apply<false>(hidden2, result);
+
+    for (int i = 0; i < Outputs; ++i)
+    {
+        output[i] = result[i];
+    }
+}
+
+void PlayerInferenceKernel::Export(PlayerModelImpl& model)
+{
+    playerEmbedding.Export(model.playerEmbed1, model.playerEmbed2, model.playerEmbed3);
+    minionEmbedding.Export(model.minionEmbed1, model.minionEmbed2, model.minionEmbed3);
+    buildingEmbedding.Export(model.buildingEmbed1, model.buildingEmbed2, model.buildingEmbed3);
+
+    actionHead.Export(model.action1, model.action2, model.action3);
+    moveHead.Export(model.move1, model.move2, model.move3);
+    entityHead.Export(model.entity1, model.entity2, model.entity3);
+}
+
+template<int Capacity>
+static void GatherUnitFeatures(const ObservedUnits<Capacity>& units, float* out)
+{
+    for (int i = 0; i < units.count; ++i, out += 5)
+    {
+        out[0] = units.position[i].x;
+        out[1] = units.position[i].y;
+        out[2] = units.velocity[i].x;
+        out[3] = units.velocity[i].y;
+        out[4] = units.health[i];
+    }
+}
+
+template<int Capacity>
+static void GatherBuildingFeatures(const ObservedBuildings<Capacity>& buildings, float* out)
+{
+    for (int i = 0; i < buildings.count; ++i, out += 3)
+    {
+        out[0] = buildings.position[i].x;
+        out[1] = buildings.position[i].y;
+        out[2] = buildings.health[i];
+    }
+}
+
+void PlayerInferenceKernel::Evaluate(const Observation& observation, float action[3], float move[2], float entity[3]) const
+{
+    float playerFeatures[MaxObservedPlayers * PlayerFeatureCount];
+    float minionFeatures[MaxObservedMinions * MinionFeatureCount];
+    float buildingFeatures[MaxObservedBuildings * BuildingFeatureCount];
+
+    GatherUnitFeatures(observation.players, playerFeatures);
+    GatherUnitFeatures(observation.minions, minionFeatures);
+    GatherBuildingFeatures(observation.buildings, buildingFeatures);
+
+    // Same layout as the torch model: player, minion and building embeddings side by side
+    alignas(64) float postRep[72];
+    playerEmbedding.Apply(playerFeatures, observation.players.count, MaxObservedPlayers, postRep);
+    minionEmbedding.Apply(minionFeatures, observation.minions.count, MaxObservedMinions, postRep + 24);
+    buildingEmbedding.Apply(buildingFeatures, observation.buildings.count, MaxObservedBuildings, postRep + 48);
+
+    actionHead.Apply(postRep, action);
+    moveHead.Apply(postRep, move);
+    entityHead.Apply(postRep, entity);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        move[i] = 1.0f / (1.0f + std::exp(-move[i]));
+    }
+}
+
+template<int Count>
+static int ArgMax(const float (&values)[Count])
+{
+    int best = 0;
+    for (int i = 1; i < Count; ++i)
+    {
+        if (values[i] > values[best])
+        {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+void PlayerInferenceKernel::Decide(const Observation& observation, TrainingLabel& output) const
+{
+    float action[3];
+    float move[2];
+    float entity[3];
+    Evaluate(observation, action, move, entity);
+
+    // log_softmax doesn't change which logit is largest, so the kernel skips it
+    output.actionIndex = ArgMax(action);
+    output.moveCoord = Vector2(move[0], move[1]);
+    output.entityChoice = ArgMax(entity);
+}
+
+static void RecordRange(float& range, const float* values, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        range = std::max(range, std::abs(values[i]));
+    }
+}
+
+template<int Features>
+static void RecordEmbeddingRanges(const EmbeddingKernel<Features>& embedding, const float* slots, int count, float (&ranges)[3])
+{
+    alignas(64) float hidden1[decltype(embedding.layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(embedding.layer2)::paddedOutputs];
+
+    // Empty slots aren't recorded, their embedding stays in float
+    for (int slot = 0; slot < count; ++slot)
+    {
+        const float* features = slots + slot * Features;
+        RecordRange(ranges[0], features, Features);
+
+        embedding.layer1.template Apply<true>(features, hidden1);
+        RecordRange(ranges[1], hidden1, 6);
+
+        embedding.layer2.template Apply<true>(hidden1, hidden2);
+        RecordRange(ranges[2], hidden2, 12);
+    }
+}
+
+template<int Outputs>
+static void RecordHeadRanges(const HeadKernel<Outputs>& head, const float* postRep, float (&ranges)[3])
+{
+    alignas(64) float hidden1[decltype(head.layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(head.layer2)::paddedOutputs];
+
+    RecordRange(ranges[0], postRep, 72);
+
+    head.layer1.template Apply<true>(postRep, hidden1);
+    RecordRange(ranges[1], hidden1, 72);
+
+    head.layer2.template Apply<true>(hidden1, hidden2);
+    RecordRange(ranges[2], hidden2, 72);
+}
+
+void ActivationRanges::Record(const PlayerInferenceKernel& kernel, const Observation& observation)
+{
+    float playerFeatures[MaxObservedPlayers * PlayerFeatureCount];
+    float minionFeatures[MaxObservedMinions * MinionFeatureCount];
+    float buildingFeatures[MaxObservedBuildings * BuildingFeatureCount];
+
+    GatherUnitFeatures(observation.players, playerFeatures);
+    GatherUnitFeatures(observation.minions, minionFeatures);
+    GatherBuildingFeatures(observation.buildings, buildingFeatures);
+
+    RecordEmbeddingRanges(kernel.playerEmbedding, playerFeatures, observation.players.count, embedding[0]);
+    RecordEmbeddingRanges(kernel.minionEmbedding, minionFeatures, observation.minions.count, embedding[1]);
+    RecordEmbeddingRanges(kernel.buildingEmbedding, buildingFeatures, observation.buildings.count, embedding[2]);
+
+    alignas(64) float postRep[72];
+    kernel.playerEmbedding.Apply(playerFeatures, observation.players.count, MaxObservedPlayers, postRep);
+    kernel.minionEmbedding.Apply(minionFeatures, observation.minions.count, MaxObservedMinions, postRep + 24);
+    kernel.buildingEmbedding.Apply(buildingFeatures, observation.buildings.count, MaxObservedBuildings, postRep + 48);
+
+    RecordHeadRanges(kernel.actionHead, postRep, head[0]);
+    RecordHeadRanges(kernel.moveHead, postRep, head[1]);
+    RecordHeadRanges(kernel.entityHead, postRep, head[2]);
+}
+
+template<int In, int Out, typename TActivation>
+void QuantizedDenseLayer<In, Out, TActivation>::Quantize(const DenseLayer<In, Out>& layer, float inputRange)
+{
+    const float maxActivation = std::numeric_limits<TActivation>::max();
+    inputScale = inputRange > 0 ? inputRange / maxActivation : 1.0f;
+
+    std::memset(weights, 0, sizeof(weights));
+    std::memset(outputScale, 0, sizeof(outputScale));
+    std::memset(bias, 0, sizeof(bias));
+
+    for (int o = 0; o < Out; ++o)
+    {
+        float maxWeight = 0;
+        for (int i = 0; i < In; ++i)
+        {
+            maxWeight = std::max(maxWeight, std::abs(layer.weights[i][o]));
+        }
+
+        float weightScale = maxWeight > 0 ? maxWeight / 127.0f : 1.0f;
+        for (int i = 0; i < In; ++i)
+        {
+            weights[i][o] = static_cast<int8_t>(std::lround(layer.weights[i][o] / weightScale));
+        }
+
+        outputScale[o] = inputScale * weightScale;
+        bias[o] = layer.bias[o];
+    }
+}
+
+template<int In, int Out, typename TActivation>
+void QuantizedDenseLayer<In, Out, TActivation>::QuantizeInput(const float* input, TActivation* output) const
+{
+    const float maxActivation = std::numeric_limits<TActivation>::max();
+
+    for (int i = 0; i < In; ++i)
+    {
+        // Activations outside the calibrated range saturate
+        float quantized = std::round(input[i] / inputScale);
+        output[i] = static_cast<TActivation>(std::min(std::max(quantized, -maxActivation), maxActivation));
+    }
+}
+
+template<int In, int Out, typename TActivation>
+template<bool Relu>
+void QuantizedDenseLayer<In, Out, TActivation>::Apply(const TActivation* input, float* output) const
+{
+    // Written as plain loops over whole padded rows, which the compiler vectorizes into widening multiply-adds
+    int32_t sums[paddedOutputs] = { };
+
+    for (int i = 0; i < In; ++i)
+    {
+        int32_t x = input[i];
+        for (int o = 0; o < paddedOutputs; ++o)
+        {
+            sums[o] += x * weights[i][o];
+        }
+    }
+
+    for (int o = 0; o < paddedOutputs; ++o)
+    {
+        float value = sums[o] * outputScale[o] + bias[o];
+        output[o] = Relu ? std::max(value, 0.0f) : value;
+    }
+}
+
+template<int Features, typename TActivation>
+void QuantizedEmbeddingKernel<Features, TActivation>::Quantize(const EmbeddingKernel<Features>& embedding, const float (&inputRanges)[3])
+{
+    layer1.Quantize(embedding.layer1, inputRanges[0]);
+    layer2.Quantize(embedding.layer2, inputRanges[1]);
+    layer3.Quantize(embedding.layer3, inputRanges[2]);
+
+    for (int i = 0; i < 24; ++i)
+    {
+        emptySlotEmbedding[i] = embedding.emptySlotEmbedding[i];
+    }
+}
+
+template<int Features, typename TActivation>
+void QuantizedEmbeddingKernel<Features, TActivation>::Apply(const float* slots, int count, int capacity, float* output) const
+{
+    TActivation quantized1[Features];
+    TActivation quantized2[6];
+    TActivation quantized3[12];
+    alignas(64) float hidden1[decltype(layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(layer2)::paddedOutputs];
+    alignas(64) float embedding[decltype(layer3)::paddedOutputs];
+
+    for (int i = 0; i < 24; ++i)
+    {
+        output[i] = 0;
+    }
+
+    for (int slot = 0; slot < count; ++slot)
+    {
+        layer1.QuantizeInput(slots + slot * Features, quantized1);
+        layer1.template Apply<true>(quantized1, hidden1);
+
+        layer2.QuantizeInput(hidden1, quantized2);
+        layer2.template Apply<true>(quantized2, hidden2);
+
+        layer3.QuantizeInput(hidden2, quantized3);
+        layer3.template Apply<false>(quantized3, embedding);
+
+        for (int i = 0; i < 24; ++i)
+        {
+            output[i] += embedding[i];
+        }
+    }
+
+    float emptySlots = static_cast<float>(capacity - count);
+    for (int i = 0; i < 24; ++i)
+    {
+        output[i] += emptySlots * emptySlotEmbedding[i];
+    }
+}
+
+template<int Outputs, typename TActivation>
+void QuantizedHeadKernel<Outputs, TActivation>::Quantize(const HeadKernel<Outputs>& head, const float (&inputRanges)[3])
+{
+    layer1.Quantize(head.layer1, inputRanges[0]);
+    layer2.Quantize(head.layer2, inputRanges[1]);
+    layer3.Quantize(head.layer3, inputRanges[2]);
+}
+
+template<int Outputs, typename TActivation>
+void QuantizedHeadKernel<Outputs, TActivation>::Apply(const float* postRep, float* output) const
+{
+    TActivation quantized[72];
+    alignas(64) float hidden1[decltype(layer1)::paddedOutputs];
+    alignas(64) float hidden2[decltype(layer2)::paddedOutputs];
+    alignas(64) float result[decltype(layer3)::paddedOutputs];
+
+    layer1.QuantizeInput(postRep, quantized);
+    layer1.template Apply<true>(quantized, hidden1);
+
+    layer2.QuantizeInput(hidden1, quantized);
+    layer2.template Apply<true>(quantized, hidden2);
+
+    layer3.QuantizeInput(hidden2, quantized);
+    layer3.template Apply<false>(quantized, result);
+
+    for (int i = 0; i < Outputs; ++i)
+    {
+        output[i] = result[i];
+    }
+}
+
+template<typename TActivation>
+void QuantizedPlayerKernel<TActivation>::Quantize(const PlayerInferenceKernel& kernel, const ActivationRanges& ranges)
+{
+    playerEmbedding.Quantize(kernel.playerEmbedding, ranges.embedding[0]);
+    minionEmbedding.Quantize(kernel.minionEmbedding, ranges.embedding[1]);
+    buildingEmbedding.Quantize(kernel.buildingEmbedding, ranges.embedding[2]);
+
+    actionHead.Quantize(kernel.actionHead, ranges.head[0]);
+    moveHead.Quantize(kernel.moveHead, ranges.head[1]);
+    entityHead.Quantize(kernel.entityHead, ranges.head[2]);
+}
+
+template<typename TActivation>
+void QuantizedPlayerKernel<TActivation>::Decide(const Observation& observation, TrainingLabel& output) const
+{
+    float playerFeatures[MaxObservedPlayers * PlayerFeatureCount];
+    float minionFeatures[MaxObservedMinions * MinionFeatureCount];
+    float buildingFeatures[MaxObservedBuildings * BuildingFeatureCount];
+
+    GatherUnitFeatures(observation.players, playerFeatures);
+    GatherUnitFeatures(observation.minions, minionFeatures);
+    GatherBuildingFeatures(observation.buildings, buildingFeatures);
+
+    alignas(64) float postRep[72];
+    playerEmbedding.Apply(playerFeatures, observation.players.count, MaxObservedPlayers, postRep);
+    minionEmbedding.Apply(minionFeatures, observation.minions.count, MaxObservedMinions, postRep + 24);
+    buildingEmbedding.Apply(buildingFeatures, observation.buildings.count, MaxObservedBuildings, postRep + 48);
+
+    float action[3];
+    float move[2];
+    float entity[3];
+    actionHead.Apply(postRep, action);
+    moveHead.Apply(postRep, move);
+    entityHead.Apply(postRep, entity);
+
+    output.actionIndex = ArgMax(action);
+    output.moveCoord = Vector2(1.0f / (1.0f + std::exp(-move[0])), 1.0f / (1.0f + std::exp(-move[1])));
+    output.entityChoice = ArgMax(entity);
+}
+
+bool CalibratePlayerKernel(
+    const PlayerInferenceKernel& kernel,
+    gsl::span<const Observation> calibrationSet,
+    ActivationRanges& outRanges)
+{
+    if (calibrationSet.empty())
+    {
+        return false;
+    }
+
+    outRanges = ActivationRanges();
+    for (auto& observation : calibrationSet)
+    {
+        outRanges.Record(kernel, observation);
+    }
+
+    return true;
+}
+
+std::shared_ptr<IQuantizedPlayerKernel> QuantizePlayerKernel(
+    const PlayerInferenceKernel& kernel,
+    InferencePrecision precision,
+    const ActivationRanges& ranges)
+{
+    if (precision == InferencePrecision::Float32)
+    {
+        return nullptr;
+    }
+
+    if (precision == InferencePrecision::Int8)
+    {
+        auto quantized = std::make_shared<QuantizedPlayerKernel<int8_t>>();
+        quantized->Quantize(kernel, ranges);
+        return quantized;
+    }
+    else
+    {
+        auto quantized = std::make_shared<QuantizedPlayerKernel<int16_t>>();
+        quantized->Quantize(kernel, ranges);
+        return quantized;
+    }
+}
+
+void ReportQuantizationAccuracy(
+    const PlayerInferenceKernel& kernel,
+    const IQuantizedPlayerKernel& quantizedKernel,
+    gsl::span<const Observation> observations)
+{
+    if (observations.empty())
+    {
+        return;
+    }
+
+    int sameAction = 0;
+    int attacks = 0;
+    int sameTarget = 0;
+    float moveError = 0;
+
+    for (auto& observation : observations)
+    {
+        TrainingLabel expected;
+        TrainingLabel actual;
+        kernel.Decide(observation, expected);
+        quantizedKernel.Decide(observation, actual);
+
+        sameAction += expected.actionIndex == actual.actionIndex;
+        moveError += (expected.moveCoord - actual.moveCoord).Length();
+
+        if (expected.actionIndex == 2)
+        {
+            ++attacks;
+            sameTarget += expected.entityChoice == actual.entityChoice;
+        }
+    }
+
+    // Time enough decisions for the clock to resolve them, cycling through the observations
+    auto decisionsPerSecond = [&](auto& decider)
+    {
+        const int decisionCount = std::max(10000, static_cast<int>(observations.size()));
+        TrainingLabel output;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < decisionCount; ++i)
+        {
+            decider.Decide(observations[i % observations.size()], output);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return decisionCount / std::max(elapsed.count(), 1e-9);
+    };
+
+    float count = static_cast<float>(observations.size());
+
+    std::cout << "Quantized player policy over " << observations.size() << " calibration samples:" << std::endl;
+    std::cout << "  Action agreement with fp32: " << 100.0f * sameAction / count << "%" << std::endl;
+    if (attacks > 0)
+    {
+        std::cout << "  Attack target agreement: " << 100.0f * sameTarget / attacks << "%" << std::endl;
+    }
+
+    std::cout << "  Mean move difference: " << moveError / count << std::endl;
+    std::cout << "  fp32 decisions/s: " << decisionsPerSecond(kernel) << std::endl;
+    std::cout << "  Quantized decisions/s: " << decisionsPerSecond(quantizedKernel) << std::endl;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "GameML.hpp"
+
+// Output width of a layer rounded up to a whole number of vector registers, so the inner loops never need a tail
+constexpr int PaddedLayerWidth(int width)
+{
+    return (width + 15) / 16 * 16;
+}
+
+// A fully connected layer with its size fixed at compile time. Weights are stored input-major, so computing the layer
+// is In broadcast-multiply-adds over a row of outputs.
+template<int In, int Out>
+struct DenseLayer
+{
+    static constexpr int inputs = In;
+    static constexpr int outputs = Out;
+    static constexpr int paddedOutputs = PaddedLayerWidth(Out);
+
+    void Export(torch::nn::Linear& layer);
+
+    template<bool Relu>
+    void Apply(const float* input, float* output) const;
+
+    alignas(64) float weights[In][paddedOutputs];
+    alignas(64) float bias[paddedOutputs];
+};
+
+template<int Features>
+struct EmbeddingKernel
+{
+    static constexpr int embeddingSize = 24;
+
+    void Export(torch::nn::Linear& layer1, torch::nn::Linear& layer2, torch::nn::Linear& layer3);
+
+    // Sums the embedding of every slot into output. Empty slots embed the zero vector, which is computed once at export.
+    void Apply(const float* slots, int count, int capacity, float* output) const;
+
+    DenseLayer<Features, 6> layer1;
+    DenseLayer<6, 12> layer2;
+    DenseLayer<12, embeddingSize> layer3;
+    alignas(64) float emptySlotEmbedding[DenseLayer<12, embeddingSize>::paddedOutputs];
+};
+
+template<int Outputs>
+struct HeadKernel
+{
+    void Export(torch::nn::Linear& layer1, torch::nn::Linear& layer2, torch::nn::Linear& layer3);
+    void Apply(const float* postRep, float* output) const;
+
+    DenseLayer<72, 72> layer1;
+    DenseLayer<72, 72> layer2;
+    DenseLayer<72, Outputs> layer3;
+};
+
+// The player policy exported out of libtorch into fixed-shape MLP kernels (AVX-512, AVX2 or scalar, whichever is the
+// widest the build has and the CPU supports). At decision batch sizes the math is a few thousand multiply-adds per
+// sample, far less than the cost of dispatching it through torch.
+struct PlayerInferenceKernel
+{
+    void Export(PlayerModelImpl& model);
+    void Decide(const Observation& observation, TrainingLabel& output) const;
+
+    // Raw head outputs: action and entity logits, and the move coordinate after the sigmoid
+    void Evaluate(const Observation& observation, float action[3], float move[2], float entity[3]) const;
+
+    EmbeddingKernel<PlayerFeatureCount> playerEmbedding;
+    EmbeddingKernel<MinionFeatureCount> minionEmbedding;
+    EmbeddingKernel<BuildingFeatureCount> buildingEmbedding;
+
+    HeadKernel<3> actionHead;
+    HeadKernel<2> moveHead;
+    HeadKernel<3> entityHead;
+};
+
+// Largest absolute value seen at the input of every layer of the float kernel, over a calibration set of observations
+struct ActivationRanges
+{
+    void Record(const PlayerInferenceKernel& kernel, const Observation& observation);
+
+    float embedding[3][3] = { };    // [player/minion/building][layer]
+    float head[3][3] = { };         // [action/move/entity][layer]
+};
+
+// A layer with int8 weights (one scale per output) that consumes activations quantized with a scale fixed at
+// calibration. Products are accumulated in int32 and rescaled to float once per output.
+template<int In, int Out, typename TActivation>
+struct QuantizedDenseLayer
+{
+    static constexpr int paddedOutputs = PaddedLayerWidth(Out);
+
+    void Quantize(const DenseLayer<In, Out>& layer, float inputRange);
+    void QuantizeInput(const float* input, TActivation* output) const;
+
+    template<bool Relu>
+    void Apply(const TActivation* input, float* output) const;
+
+    alignas(64) int8_t weights[In][paddedOutputs];
+    alignas(64) float outputScale[paddedOutputs];
+    alignas(64) float bias[paddedOutputs];
+    float inputScale;
+};
+
+template<int Features, typename TActivation>
+struct QuantizedEmbeddingKernel
+{
+    void Quantize(const EmbeddingKernel<Features>& embedding, const float (&inputRanges)[3]);
+    void Apply(const float* slots, int count, int capacity, float* output) const;
+
+    QuantizedDenseLayer<Features, 6, TActivation> layer1;
+    QuantizedDenseLayer<6, 12, TActivation> layer2;
+    QuantizedDenseLayer<12, 24, TActivation> layer3;
+    float emptySlotEmbedding[24];
+};
+
+template<int Outputs, typename TActivation>
+struct QuantizedHeadKernel
+{
+    void Quantize(const HeadKernel<Outputs>& head, const float (&inputRanges)[3]);
+    void Apply(const float* postRep, float* output) const;
+
+    QuantizedDenseLayer<72, 72, TActivation> layer1;
+    QuantizedDenseLayer<72, 72, TActivation> layer2;
+    QuantizedDenseLayer<72, Outputs, TActivation> layer3;
+};
+
+struct IQuantizedPlayerKernel
+{
+    virtual ~IQuantizedPlayerKernel() = default;
+    virtual void Decide(const Observation& observation, TrainingLabel& output) const = 0;
+};
+
+// The player policy with int8 weights, built from the float kernel and a calibration set of observations
+template<typename TActivation>
+struct QuantizedPlayerKernel : IQuantizedPlayerKernel
+{
+    void Quantize(const PlayerInferenceKernel& kernel, const ActivationRanges& ranges);
+    void Decide(const Observation& observation, TrainingLabel& output) const override;
+
+    QuantizedEmbeddingKernel<PlayerFeatureCount, TActivation> playerEmbedding;
+    QuantizedEmbeddingKernel<MinionFeatureCount, TActivation> minionEmbedding;
+    QuantizedEmbeddingKernel<BuildingFeatureCount, TActivation> buildingEmbedding;
+
+    QuantizedHeadKernel<3, TActivation> actionHead;
+    QuantizedHeadKernel<2, TActivation> moveHead;
+    QuantizedHeadKernel<3, TActivation> entityHead;
+};
+
+// Runs the float kernel over the calibration set to find its activation ranges. Returns false if the set is empty.
+bool CalibratePlayerKernel(
+    const PlayerInferenceKernel& kernel,
+    gsl::span<const Observation> calibrationSet,
+    ActivationRanges& outRanges);
+
+// Quantizes the float kernel's weights, with activations scaled by ranges from an earlier calibration
+std::shared_ptr<IQuantizedPlayerKernel> QuantizePlayerKernel(
+    const PlayerInferenceKernel& kernel,
+    InferencePrecision precision,
+    const ActivationRanges& ranges);
+
+// Logs how often the quantized kernel picks the same action as the float kernel, and the throughput of both
+void ReportQuantizationAccuracy(
+    const PlayerInferenceKernel& kernel,
+    const IQuantizedPlayerKernel& quantizedKernel,
+    gsl::span<const Observation> observations);
@@ -0,0 +1,113 @@
+#include "PlayerInferenceSimd.hpp"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+template<int In, int PaddedOut>
+void DenseApplyScalar(const float* input, const float* weights, const float* bias, bool relu, float* output)
+{
+    for (int o = 0; o < PaddedOut; ++o)
+    {
+        output[o] = bias[o];
+    }
+
+    for (int i = 0; i < In; ++i)
+    {
+        const float* row = weights + i * PaddedOut;
+        for (int o = 0; o < PaddedOut; ++o)
+        {
+            output[o] += input[i] * row[o];
+        }
+    }
+
+    if (relu)
+    {
+        for (int o = 0; o < PaddedOut; ++o)
+        {
+            output[o] = std::max(output[o], 0.0f);
+        }
+    }
+}
+
+#if defined(_MSC_VER)
+// CPUID only says what the CPU has, the OS also has to save the wider registers on context switches
+static bool CpuSupports(int leaf, int registerIndex, int bit, unsigned long long osStateMask)
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < leaf)
+    {
+        return false;
+    }
+
+    __cpuidex(info, leaf, 0);
+    if ((info[registerIndex] & (1 << bit)) == 0)
+    {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    bool osSavesState = (info[2] & (1 << 27)) != 0;
+    return osSavesState && (_xgetbv(0) & osStateMask) == osStateMask;
+}
+
+static bool SupportsAvx2() { return CpuSupports(7, 1, 5, 0x6) && CpuSupports(1, 2, 12, 0x6); }
+static bool SupportsAvx512() { return CpuSupports(7, 1, 16, 0xE6) && CpuSupports(1, 2, 12, 0x6); }
+#else
+static bool SupportsAvx2() { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"); }
+static bool SupportsAvx512() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("fma"); }
+#endif
+
+enum class DenseApplyIsa { Scalar, Avx2, Avx512 };
+
+static DenseApplyIsa SelectDenseApplyIsa()
+{
+#if defined(SINGLEPLAYER_KERNEL_AVX512)
+    if (SupportsAvx512()) return DenseApplyIsa::Avx512;
+#endif
+#if defined(SINGLEPLAYER_KERNEL_AVX2)
+    if (SupportsAvx2()) return DenseApplyIsa::Avx2;
+#endif
+
+    return DenseApplyIsa::Scalar;
+}
+
+static DenseApplyIsa GetDenseApplyIsa()
+{
+    static const DenseApplyIsa isa = SelectDenseApplyIsa();
+    return isa;
+}
+
+template<int In, int PaddedOut>
+DenseApplyFunction<In, PaddedOut> GetDenseApply()
+{
+    switch (GetDenseApplyIsa())
+    {
+#if defined(SINGLEPLAYER_KERNEL_AVX512)
+        case DenseApplyIsa::Avx512: return DenseApplyAvx512<In, PaddedOut>;
+#endif
+#if defined(SINGLEPLAYER_KERNEL_AVX2)
+        case DenseApplyIsa::Avx2: return DenseApplyAvx2<In, PaddedOut>;
+#endif
+        default: return DenseApplyScalar<In, PaddedOut>;
+    }
+}
+
+const char* GetDenseApplyName()
+{
+    switch (GetDenseApplyIsa())
+    {
+        case DenseApplyIsa::Avx512: return "AVX-512";
+        case DenseApplyIsa::Avx2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
+#define INSTANTIATE_DENSE_APPLY(In, PaddedOut) \
+    template void DenseApplyScalar<In, PaddedOut>(const float*, const float*, const float*, bool, float*); \
+    template DenseApplyFunction<In, PaddedOut> GetDenseApply<In, PaddedOut>();
+PLAYER_KERNEL_DENSE_SHAPES(INSTANTIATE_DENSE_APPLY)
@@ -0,0 +1,36 @@
+#pragma once
+
+// The inner loop of the player policy's inference kernel: output = input * weights + bias, over a layer whose weights
+// are stored input-major in rows of PaddedOut floats. The AVX2 and AVX-512 versions live in their own translation
+// units, compiled for those instruction sets, which include nothing but intrinsics. That keeps wider instructions out
+// of inline functions shared with the rest of the program (torch and engine headers), and lets one build pick the
+// widest version the CPU it runs on supports.
+//
+// Every version is a template on the layer's shape, so the compiler sees both loop bounds and unrolls them. Each
+// translation unit instantiates its version for the shapes in PLAYER_KERNEL_DENSE_SHAPES.
+template<int In, int PaddedOut>
+using DenseApplyFunction =
+    void(*)(const float* input, const float* weights, const float* bias, bool relu, float* output);
+
+// (inputs, padded outputs) of every layer in PlayerInferenceKernel. A layer whose shape is missing here fails to link.
+#define PLAYER_KERNEL_DENSE_SHAPES(X) \
+    X(5, 16)    /* player and minion embedding layer 1 */ \
+    X(3, 16)    /* building embedding layer 1 */ \
+    X(6, 16)    /* embedding layer 2 */ \
+    X(12, 32)   /* embedding layer 3 */ \
+    X(72, 80)   /* head layers 1 and 2 */ \
+    X(72, 16)   /* head layer 3 */
+
+// Picked once per process, from the versions this build has and the instruction sets the CPU supports
+template<int In, int PaddedOut>
+DenseApplyFunction<In, PaddedOut> GetDenseApply();
+const char* GetDenseApplyName();
+
+template<int In, int PaddedOut>
+void DenseApplyScalar(const float* input, const float* weights, const float* bias, bool relu, float* output);
+
+template<int In, int PaddedOut>
+void DenseApplyAvx2(const float* input, const float* weights, const float* bias, bool relu, float* output);
+
+template<int In, int PaddedOut>
+void DenseApplyAvx512(const float* input, const float* weights, const float* bias, bool relu, float* output);
@@ -1,30 +1,159 @@
 #pragma once
 
 #include "PlayerNeuralNetworkService.hpp"
+#include "Profiler.hpp"
 #include "InputService.hpp"
 #include "MinionEntity.hpp"
 #include "CastleEntity.hpp"
+#include "GameMetrics.hpp"
+#include "Tools/ConsoleVar.hpp"
+
+ConsoleVar<bool> g_asyncDecisions("nn-async-decisions", false);
+ConsoleVar<int> g_decisionLatency("nn-decision-latency", 1);
+ConsoleVar<int> g_observationThreads("nn-observation-threads", -1);   // -1: one per core besides the tick thread
 
 PlayerNeuralNetworkService::PlayerNeuralNetworkService(StrifeML::NetworkContext<PlayerNetwork>* context, InputService* inputService)
 	: NeuralNetworkService<PlayerEntity, PlayerNetwork>(context, 128),
-	inputService(inputService)
+	inputService(inputService),
+	networkContext(context)
 {
+	inputService->nnService = this;
+}
+
+void PlayerNeuralNetworkService::ReceiveEvent(const IEntityEvent& ev)
+{
+	if (!g_asyncDecisions.Value())
+	{
+		// Switching back to synchronous decisions drops whatever was still in flight
+		decisionPipeline.reset();
+		NeuralNetworkService<PlayerEntity, PlayerNetwork>::ReceiveEvent(ev);
+		return;
+	}
+
+	if (!ev.Is<UpdateEvent>())
+	{
+		NeuralNetworkService<PlayerEntity, PlayerNetwork>::ReceiveEvent(ev);
+		return;
+	}
+
+	if (decisionPipeline == nullptr)
+	{
+		decisionPipeline = std::make_unique<PlayerDecisionPipeline>(networkContext->decider->network.get());
+	}
+
+	++tick;
+	ApplyDueDecisions();
+	SnapshotDecisionInputs();
+
+	if (networkContext->trainer != nullptr)
+	{
+		CollectTrainingSamples(networkContext->trainer);
+	}
+}
+
+void PlayerNeuralNetworkService::ApplyDueDecisions()
+{
+	uint64_t latency = std::max(1, g_decisionLatency.Value());
+	if (tick < latency)
+	{
+		return;
+	}
+
+	while (auto batch = decisionPipeline->TakeDueBatch(tick - latency))
+	{
+		for (int i = 0; i < batch->entities.size(); ++i)
+		{
+			// Players destroyed since the snapshot no longer have anyone to apply the decision to
+			PlayerEntity* player;
+			if (batch->entities[i].TryGetValue(player))
+			{
+				ReceiveDecision(player, batch->outputs[i]);
+			}
+			else
+			{
+				g_gameMetrics.decisionsSkipped.Add();
+			}
+		}
+
+		decisionPipeline->Recycle(std::move(batch));
+	}
+}
+
+void PlayerNeuralNetworkService::SnapshotDecisionInputs()
+{
+	auto batch = decisionPipeline->AcquireBatch();
+	batch->snapshotTick = tick;
+
+	snapshotPlayers.clear();
+	for (auto player : scene->GetEntitiesOfType<PlayerEntity>())
+	{
+		snapshotPlayers.push_back(player);
+		batch->entities.emplace_back(player);
+	}
+
+	batch->inputs.resize(snapshotPlayers.size());
+
+	int threadCount = g_observationThreads.Value() < 0
+		? std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1)
+		: g_observationThreads.Value();
+	if (observationWorkers == nullptr || observationWorkers->ThreadCount() != threadCount)
+	{
+		observationWorkers = std::make_unique<WorkerPool>(threadCount);
+	}
+
+	// Each player's observation is gathered on its own thread. This is only safe because nothing writes to the scene
+	// until ParallelFor returns: the tick thread is inside it too, and physics and entity updates don't run meanwhile.
+	// GetObservation reads entity centers and components, rigid body velocities and the spatial hash's cells, and
+	// its searches keep their scratch state per thread. Anything added to it has to stay read-only. Build with
+	// SINGLEPLAYER_TSAN and run with nn-async-decisions 1 and nn-observation-threads > 0 to check a change.
+	observationWorkers->ParallelFor(static_cast<int>(snapshotPlayers.size()), [&](int i)
+	{
+		CollectInput(snapshotPlayers[i], batch->inputs[i]);
+	});
+
+	if (batch->inputs.empty())
+	{
+		decisionPipeline->Recycle(std::move(batch));
+		return;
+	}
+
+	decisionPipeline->Submit(std::move(batch));
 }
 
 void PlayerNeuralNetworkService::CollectInput(PlayerEntity* entity, InputType& input)
 {
+	PROFILE_ZONE("PlayerNeuralNetworkService::CollectInput");
+
 	entity->GetObservation(input);
 }
 
 void PlayerNeuralNetworkService::ReceiveDecision(PlayerEntity* entity, OutputType& output)
 {
-	//output.actionIndex = 0 = none = continue previous action
+	PROFILE_ZONE("PlayerNeuralNetworkService::ReceiveDecision");
+
 	PlayerEntity* player;
 	if (inputService->activePlayer.TryGetValue(player) && player == entity)
 	{
 		return;
 	}
 
+	if (inputService->recording != nullptr)
+	{
+		// Replays apply the recorded decisions on the step they were made instead, from InputService::ReplayInputs
+		if (inputService->recording->IsReplaying())
+		{
+			return;
+		}
+
+		inputService->recording->Record(inputService->SimulationStepIndex(), entity->id, output);
+	}
+
+	ApplyDecision(entity, output);
+}
+
+void PlayerNeuralNetworkService::ApplyDecision(PlayerEntity* entity, const OutputType& output)
+{
+	//output.actionIndex = 0 = none = continue previous action
 	if (output.actionIndex == 1)
 	{
 		entity->MoveTo(Vector2(output.moveCoord.x * 4096.0f + 32.0f, output.moveCoord.y * 1408.0f + 1376.0f));
@@ -66,6 +195,8 @@ void PlayerNeuralNetworkService::ReceiveDecision(PlayerEntity* entity, OutputTyp
 
 void PlayerNeuralNetworkService::CollectTrainingSamples(TrainerType* trainer)
 {
+	PROFILE_ZONE("PlayerNeuralNetworkService::CollectTrainingSamples");
+
 	PlayerEntity* player;
 	if (inputService->activePlayer.TryGetValue(player))
 	{
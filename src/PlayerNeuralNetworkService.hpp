@@ -1,6 +1,8 @@
 #pragma once
 
 #include "PlayerEntity.hpp"
+#include "PlayerDecisionPipeline.hpp"
+#include "WorkerPool.hpp"
 #include "ML/NeuralNetworkService.hpp"
 
 class InputService;
@@ -9,11 +11,28 @@ struct PlayerNeuralNetworkService : NeuralNetworkService<PlayerEntity, PlayerNet
 {
 	PlayerNeuralNetworkService(StrifeML::NetworkContext<PlayerNetwork>* context, InputService* inputService);
 	
+	void ReceiveEvent(const IEntityEvent& ev) override;
+
 	void CollectInput(PlayerEntity* entity, InputType& input) override;
 
 	void ReceiveDecision(PlayerEntity* entity, OutputType& output) override;
+	void ApplyDecision(PlayerEntity* entity, const OutputType& output);
 
 	void CollectTrainingSamples(TrainerType* trainer) override;
 
 	InputService* inputService;
+
+private:
+	// Async mode: decisions for a snapshot taken at tick T are applied at tick T + nn-decision-latency
+	void ApplyDueDecisions();
+	void SnapshotDecisionInputs();
+
+	StrifeML::NetworkContext<PlayerNetwork>* networkContext;
+	std::unique_ptr<PlayerDecisionPipeline> decisionPipeline;
+
+	// Spreads the async snapshot's observations over nn-observation-threads threads. Only observation gathering runs in
+	// parallel; the scene itself, and with it every entity and service update, still steps on the tick thread.
+	std::unique_ptr<WorkerPool> observationWorkers;
+	std::vector<PlayerEntity*> snapshotPlayers;
+	uint64_t tick = 0;
 };
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include "PlayerSampleStore.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::is_trivially_copyable<PlayerSampleRecord>::value, "Sample records are written through the mapping");
+
+static constexpr uint32_t SampleStoreMagic = 0x53504C52;    // "RLPS"
+static constexpr uint32_t SampleStoreVersion = 1;
+
+// The file grows by this many records at a time, so appends only remap occasionally
+static constexpr uint64_t SampleStoreGrowth = 64 * 1024;
+
+struct SampleStoreHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t capacity;
+    uint8_t padding[32];
+};
+
+static_assert(sizeof(SampleStoreHeader) == 64, "Records start on a cache line");
+
+static uint64_t StoreBytes(uint64_t capacity)
+{
+    return sizeof(SampleStoreHeader) + capacity * sizeof(PlayerSampleRecord);
+}
+
+template<int Capacity>
+static void WriteUnits(const ObservedUnits<Capacity>& units, int32_t& count, float (*position)[2], float (*velocity)[2], float* health)
+{
+    count = units.count;
+    for (int i = 0; i < Capacity; ++i)
+    {
+        position[i][0] = units.position[i].x;
+        position[i][1] = units.position[i].y;
+        velocity[i][0] = units.velocity[i].x;
+        velocity[i][1] = units.velocity[i].y;
+        health[i] = units.health[i];
+    }
+}
+
+template<int Capacity>
+static void ReadUnits(ObservedUnits<Capacity>& units, int32_t count, const float (*position)[2], const float (*velocity)[2], const float* health)
+{
+    units.count = std::min(std::max(count, 0), Capacity);
+    for (int i = 0; i < Capacity; ++i)
+    {
+        units.position[i] = Vector2(position[i][0], position[i][1]);
+        units.velocity[i] = Vector2(velocity[i][0], velocity[i][1]);
+        units.health[i] = health[i];
+    }
+}
+
+static void WriteRecord(const PlayerSampleStore::SampleType& sample, PlayerSampleRecord& record)
+{
+    const Observation& observation = sample.input;
+
+    WriteUnits(observation.players, record.playerCount, record.playerPosition, record.playerVelocity, record.playerHealth);
+    WriteUnits(observation.minions, record.minionCount, record.minionPosition, record.minionVelocity, record.minionHealth);
+
+    record.buildingCount = observation.buildings.count;
+    for (int i = 0; i < MaxObservedBuildings; ++i)
+    {
+        record.buildingPosition[i][0] = observation.buildings.position[i].x;
+        record.buildingPosition[i][1] = observation.buildings.position[i].y;
+        record.buildingHealth[i] = observation.buildings.health[i];
+    }
+
+    record.actionIndex = sample.output.actionIndex;
+    record.moveCoord[0] = sample.output.moveCoord.x;
+    record.moveCoord[1] = sample.output.moveCoord.y;
+    record.entityChoice = sample.output.entityChoice;
+}
+
+static void ReadRecord(const PlayerSampleRecord& record, PlayerSampleStore::SampleType& sample)
+{
+    Observation& observation = sample.input;
+
+    ReadUnits(observation.players, record.playerCount, record.playerPosition, record.playerVelocity, record.playerHealth);
+    ReadUnits(observation.minions, record.minionCount, record.minionPosition, record.minionVelocity, record.minionHealth);
+
+    observation.buildings.count = std::min(std::max(record.buildingCount, 0), MaxObservedBuildings);
+    for (int i = 0; i < MaxObservedBuildings; ++i)
+    {
+        observation.buildings.position[i] = Vector2(record.buildingPosition[i][0], record.buildingPosition[i][1]);
+        observation.buildings.health[i] = record.buildingHealth[i];
+    }
+
+    sample.output.actionIndex = record.actionIndex;
+    sample.output.moveCoord = Vector2(record.moveCoord[0], record.moveCoord[1]);
+    sample.output.entityChoice = record.entityChoice;
+}
+
+PlayerSampleStore::~PlayerSampleStore()
+{
+    Close();
+}
+
+bool PlayerSampleStore::Open(const std::string& storePath)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    Unmap();
+    path = storePath;
+
+    uint64_t fileBytes = 0;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cout << "Failed to open sample store " << path << std::endl;
+        return false;
+    }
+
+    fileHandle = file;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    fileBytes = size.QuadPart;
+#else
+    fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fileDescriptor < 0)
+    {
+        std::cout << "Failed to open sample store " << path << std::endl;
+        return false;
+    }
+
+    struct stat status;
+    fstat(fileDescriptor, &status);
+    fileBytes = status.st_size;
+#endif
+
+    if (fileBytes < sizeof(SampleStoreHeader))
+    {
+        if (!MapCapacity(SampleStoreGrowth))
+        {
+            return false;
+        }
+
+        SampleStoreHeader* header = GetHeader();
+        std::memset(header, 0, sizeof(SampleStoreHeader));
+        header->magic = SampleStoreMagic;
+        header->version = SampleStoreVersion;
+        header->recordSize = sizeof(PlayerSampleRecord);
+        header->capacity = SampleStoreGrowth;
+
+        return true;
+    }
+
+    uint64_t capacity = (fileBytes - sizeof(SampleStoreHeader)) / sizeof(PlayerSampleRecord);
+    if (!MapCapacity(capacity))
+    {
+        return false;
+    }
+
+    SampleStoreHeader* header = GetHeader();
+    if (header->magic != SampleStoreMagic
+        || header->version != SampleStoreVersion
+        || header->recordSize != sizeof(PlayerSampleRecord)
+        || header->count > capacity)
+    {
+        std::cout << "Sample store " << path << " has an incompatible format" << std::endl;
+        Unmap();
+        return false;
+    }
+
+    header->capacity = capacity;
+    for (uint64_t i = 0; i < header->count; ++i)
+    {
+        IndexRecord(i);
+    }
+
+    std::cout << "Opened sample store " << path << " with " << header->count << " samples" << std::endl;
+
+    return true;
+}
+
+void PlayerSampleStore::Close()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    Unmap();
+}
+
+void PlayerSampleStore::Append(const SampleType& sample)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (mappedBase == nullptr)
+    {
+        return;
+    }
+
+    SampleStoreHeader* header = GetHeader();
+    if (header->count == header->capacity)
+    {
+        uint64_t newCapacity = header->capacity + SampleStoreGrowth;
+        if (!MapCapacity(newCapacity))
+        {
+            return;
+        }
+
+        header = GetHeader();
+        header->capacity = newCapacity;
+    }
+
+    // The count is only bumped once the record is written, so a crash mid-append never exposes a partial record
+    WriteRecord(sample, GetRecords()[header->count]);
+    IndexRecord(header->count);
+    ++header->count;
+}
+
+uint64_t PlayerSampleStore::Size() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return mappedBase != nullptr ? GetHeader()->count : 0;
+}
+
+bool PlayerSampleStore::TryReadSequence(uint64_t firstIndex, gsl::span<SampleType> outSequence)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (mappedBase == nullptr || firstIndex + outSequence.size() > GetHeader()->count)
+    {
+        return false;
+    }
+
+    const PlayerSampleRecord* records = GetRecords() + firstIndex;
+    for (int i = 0; i < outSequence.size(); ++i)
+    {
+        ReadRecord(records[i], outSequence[i]);
+    }
+
+    return true;
+}
+
+bool PlayerSampleStore::TryDrawByAction(const float (&actionWeights)[ActionCount], std::minstd_rand& random, gsl::span<SampleType> outSamples)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    float cumulativeWeight[ActionCount];
+    float totalWeight = 0;
+    for (int i = 0; i < ActionCount; ++i)
+    {
+        totalWeight += indicesByAction[i].empty() ? 0.0f : std::max(actionWeights[i], 0.0f);
+        cumulativeWeight[i] = totalWeight;
+    }
+
+    if (mappedBase == nullptr || totalWeight <= 0)
+    {
+        return false;
+    }
+
+    std::uniform_real_distribution<float> pickWeight(0.0f, totalWeight);
+    for (auto& sample : outSamples)
+    {
+        float weight = pickWeight(random);
+        int action = 0;
+        while (action < ActionCount - 1 && (weight >= cumulativeWeight[action] || indicesByAction[action].empty()))
+        {
+            ++action;
+        }
+
+        // Rounding can leave the pick past the last non-empty action
+        while (indicesByAction[action].empty())
+        {
+            --action;
+        }
+
+        const std::vector<uint64_t>& indices = indicesByAction[action];
+        std::uniform_int_distribution<size_t> pickIndex(0, indices.size() - 1);
+        ReadRecord(GetRecords()[indices[pickIndex(random)]], sample);
+    }
+
+    return true;
+}
+
+void PlayerSampleStore::IndexRecord(uint64_t index)
+{
+    int32_t action = GetRecords()[index].actionIndex;
+    if (action >= 0 && action < ActionCount)
+    {
+        indicesByAction[action].push_back(index);
+    }
+}
+
+bool PlayerSampleStore::MapCapacity(uint64_t capacity)
+{
+    uint64_t bytes = StoreBytes(capacity);
+
+#ifdef _WIN32
+    if (mappedBase != nullptr)
+    {
+        UnmapViewOfFile(mappedBase);
+        CloseHandle(mappingHandle);
+        mappedBase = nullptr;
+        mappingHandle = nullptr;
+    }
+
+    // Creating a mapping larger than the file extends it
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32), static_cast<DWORD>(bytes), nullptr);
+    if (mappingHandle != nullptr)
+    {
+        mappedBase = static_cast<uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, bytes));
+    }
+#else
+    if (mappedBase != nullptr)
+    {
+        munmap(mappedBase, mappedBytes);
+        mappedBase = nullptr;
+    }
+
+    if (ftruncate(fileDescriptor, bytes) == 0)
+    {
+        void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+        mappedBase = base != MAP_FAILED ? static_cast<uint8_t*>(base) : nullptr;
+    }
+#endif
+
+    if (mappedBase == nullptr)
+    {
+        std::cout << "Failed to map sample store " << path << std::endl;
+        Unmap();
+        return false;
+    }
+
+    mappedBytes = bytes;
+    return true;
+}
+
+void PlayerSampleStore::Unmap()
+{
+#ifdef _WIN32
+    if (mappedBase != nullptr) UnmapViewOfFile(mappedBase);
+    if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+    if (fileHandle != nullptr) CloseHandle(fileHandle);
+
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mappedBase != nullptr) munmap(mappedBase, mappedBytes);
+    if (fileDescriptor >= 0) close(fileDescriptor);
+
+    fileDescriptor = -1;
+#endif
+
+    mappedBase = nullptr;
+    mappedBytes = 0;
+
+    for (auto& indices : indicesByAction)
+    {
+        indices.clear();
+    }
+}
+
+SampleStoreHeader* PlayerSampleStore::GetHeader() const
+{
+    return reinterpret_cast<SampleStoreHeader*>(mappedBase);
+}
+
+PlayerSampleRecord* PlayerSampleStore::GetRecords() const
+{
+    return reinterpret_cast<PlayerSampleRecord*>(mappedBase + sizeof(SampleStoreHeader));
+}
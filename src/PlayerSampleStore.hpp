@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GameML.hpp"
+
+struct SampleStoreHeader;
+
+// One sample as laid out on disk. Plain data only, so records can be read and written straight through the mapping.
+struct PlayerSampleRecord
+{
+    int32_t playerCount;
+    int32_t minionCount;
+    int32_t buildingCount;
+    int32_t actionIndex;
+    int32_t entityChoice;
+    float moveCoord[2];
+
+    float playerPosition[MaxObservedPlayers][2];
+    float playerVelocity[MaxObservedPlayers][2];
+    float playerHealth[MaxObservedPlayers];
+
+    float minionPosition[MaxObservedMinions][2];
+    float minionVelocity[MaxObservedMinions][2];
+    float minionHealth[MaxObservedMinions];
+
+    float buildingPosition[MaxObservedBuildings][2];
+    float buildingHealth[MaxObservedBuildings];
+};
+
+// An append-only file of fixed-size sample records, memory-mapped so that the trainer can sample from millions of
+// samples without reading them into memory. The sample count lives in the header. Reopening a store maps it and reads
+// each record's action, to index the records by action.
+class PlayerSampleStore
+{
+public:
+    using SampleType = PlayerNetwork::SampleType;
+    static constexpr int ActionCount = 3;
+
+    ~PlayerSampleStore();
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return mappedBase != nullptr; }
+
+    void Append(const SampleType& sample);
+    uint64_t Size() const;
+
+    // Copies out consecutive samples starting at the given index
+    bool TryReadSequence(uint64_t firstIndex, gsl::span<SampleType> outSequence);
+
+    // Fills outSamples by picking each sample's action by weight and then a uniformly random stored sample of that
+    // action. Actions with no stored samples are skipped and their weight goes to the others. Returns false, and leaves
+    // outSamples alone, if none of the weighted actions has any.
+    bool TryDrawByAction(const float (&actionWeights)[ActionCount], std::minstd_rand& random, gsl::span<SampleType> outSamples);
+
+private:
+    bool MapCapacity(uint64_t capacity);
+    void Unmap();
+    SampleStoreHeader* GetHeader() const;
+    PlayerSampleRecord* GetRecords() const;
+    void IndexRecord(uint64_t index);
+
+    mutable std::mutex mutex;
+    std::string path;
+    uint8_t* mappedBase = nullptr;
+    uint64_t mappedBytes = 0;
+    std::vector<uint64_t> indicesByAction[ActionCount];
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+};
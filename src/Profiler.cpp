@@ -0,0 +1,124 @@
+#include "Profiler.hpp"
+
+#ifdef SINGLEPLAYER_PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Tools/Console.hpp"
+
+namespace Profiler
+{
+    struct ZoneRecord
+    {
+        const char* name;
+        int64_t start;
+        int64_t end;
+    };
+
+    // Only the owning thread writes. Dumps read the newest records and skip a margin at the old end of the ring,
+    // since the owner may be overwriting those while they're read.
+    struct ThreadBuffer
+    {
+        static constexpr uint64_t Capacity = 1 << 16;
+        static constexpr uint64_t DumpMargin = 1024;
+
+        ZoneRecord records[Capacity];
+        std::atomic<uint64_t> written { 0 };
+        int threadId = 0;
+    };
+
+    static std::mutex g_buffersMutex;
+    static std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+
+    static ThreadBuffer& GetThreadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (buffer == nullptr)
+        {
+            buffer = std::make_shared<ThreadBuffer>();
+
+            // Buffers stay registered after their thread exits, so its zones still show up in the next dump
+            std::lock_guard<std::mutex> guard(g_buffersMutex);
+            buffer->threadId = static_cast<int>(g_buffers.size());
+            g_buffers.push_back(buffer);
+        }
+
+        return *buffer;
+    }
+
+    void RecordZone(const char* name, int64_t startNanoseconds, int64_t endNanoseconds)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        uint64_t index = buffer.written.load(std::memory_order_relaxed);
+        buffer.records[index % ThreadBuffer::Capacity] = { name, startNanoseconds, endNanoseconds };
+        buffer.written.store(index + 1, std::memory_order_release);
+    }
+
+    static bool WriteChromeTrace(const std::string& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            return false;
+        }
+
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> guard(g_buffersMutex);
+            buffers = g_buffers;
+        }
+
+        file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        bool first = true;
+
+        for (auto& buffer : buffers)
+        {
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            uint64_t count = std::min(written, ThreadBuffer::Capacity - ThreadBuffer::DumpMargin);
+
+            for (uint64_t i = written - count; i < written; ++i)
+            {
+                const ZoneRecord& record = buffer->records[i % ThreadBuffer::Capacity];
+
+                // Complete events, timestamps in microseconds
+                file << (first ? "" : ",")
+                    << "{\"name\":\"" << record.name
+                    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadId
+                    << ",\"ts\":" << record.start / 1000.0
+                    << ",\"dur\":" << (record.end - record.start) / 1000.0 << "}";
+                first = false;
+            }
+        }
+
+        file << "]}";
+        return true;
+    }
+}
+
+void ProfilerDumpCmd(ConsoleCommandBinder& binder)
+{
+    std::string path = "trace.json";
+    binder
+        .Bind(path, "path")
+        .Help("Write the recent profiler zones of every thread as a Chrome trace");
+
+    if (Profiler::WriteChromeTrace(path))
+    {
+        std::cout << "Wrote profiler trace to " << path << std::endl;
+    }
+    else
+    {
+        std::cout << "Failed to write " << path << std::endl;
+    }
+}
+
+ConsoleCmd g_profilerDumpCmd("profiler-dump", ProfilerDumpCmd);
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+// Scoped timing zones, recorded into per-thread ring buffers and dumped as a Chrome trace (chrome://tracing or
+// Perfetto) with the profiler-dump console command. Without SINGLEPLAYER_PROFILER the zones compile to nothing.
+//
+//     void PlayerEntity::FixedUpdate(float deltaTime)
+//     {
+//         PROFILE_ZONE("PlayerEntity::FixedUpdate");
+//         ...
+//     }
+
+#ifdef SINGLEPLAYER_PROFILER
+
+#include <chrono>
+#include <cstdint>
+
+namespace Profiler
+{
+    inline int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Appends to the calling thread's ring buffer. The name must outlive the profiler, which string literals do.
+    void RecordZone(const char* name, int64_t startNanoseconds, int64_t endNanoseconds);
+
+    class ScopedZone
+    {
+    public:
+        explicit ScopedZone(const char* name)
+            : name(name),
+            start(Now())
+        {
+        }
+
+        ~ScopedZone()
+        {
+            RecordZone(name, start, Now());
+        }
+
+    private:
+        const char* name;
+        int64_t start;
+    };
+}
+
+#define PROFILE_ZONE_CONCAT_INNER(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ::Profiler::ScopedZone PROFILE_ZONE_CONCAT(profileZone_, __LINE__)(name)
+
+#else
+
+#define PROFILE_ZONE(name) do { } while (false)
+
+#endif
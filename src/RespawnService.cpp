@@ -0,0 +1,34 @@
+#include "RespawnService.hpp"
+#include "CastleEntity.hpp"
+#include "Tools/ConsoleVar.hpp"
+
+ConsoleVar<float> g_respawnDelay("respawn-delay", 0.0f);
+
+void RespawnService::QueueRespawn(CastleEntity* castle)
+{
+    pending.push_back({ EntityReference<CastleEntity>(castle), g_respawnDelay.Value() });
+}
+
+void RespawnService::FixedUpdate(float deltaTime)
+{
+    for (int i = static_cast<int>(pending.size()) - 1; i >= 0; --i)
+    {
+        auto& respawn = pending[i];
+        respawn.timeLeft -= deltaTime;
+
+        if (respawn.timeLeft > 0)
+        {
+            continue;
+        }
+
+        // Castles that were destroyed in the meantime don't respawn anyone
+        CastleEntity* castle;
+        if (respawn.castle.TryGetValue(castle))
+        {
+            castle->SpawnPlayer();
+        }
+
+        respawn = pending.back();
+        pending.pop_back();
+    }
+}
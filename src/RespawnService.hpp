@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "Scene/Scene.hpp"
+#include "Scene/IEntityEvent.hpp"
+
+struct CastleEntity;
+
+// Sent to a player's castle when the player is destroyed
+DEFINE_EVENT(PlayerDestroyedEvent)
+{
+    PlayerDestroyedEvent()
+    {
+    }
+};
+
+// Respawns players a while after they're destroyed. Castles queue a respawn when one of their players is destroyed, so
+// nothing is checked while every roster is full.
+class RespawnService : public ISceneService
+{
+public:
+    void QueueRespawn(CastleEntity* castle);
+
+    // Counts down the pending respawns, stepped by the SimulationStepEntity
+    void FixedUpdate(float deltaTime);
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+private:
+    struct PendingRespawn
+    {
+        EntityReference<CastleEntity> castle;
+        float timeLeft;
+    };
+
+    std::vector<PendingRespawn> pending;
+};
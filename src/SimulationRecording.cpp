@@ -0,0 +1,196 @@
+#include "SimulationRecording.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+#include "GameML.hpp"
+#include "Tools/ConsoleVar.hpp"
+
+ConsoleVar<int> g_simulationSeed("sim-seed", 0);
+ConsoleVar<std::string> g_recordPath("sim-record", "");
+ConsoleVar<std::string> g_replayPath("sim-replay", "");
+
+static constexpr uint32_t RecordingMagic = 0x32455253;  // "SRE2", records carry their step
+
+std::unique_ptr<SimulationRecording> SimulationRecording::CreateFromConsoleVars()
+{
+    auto recording = std::make_unique<SimulationRecording>();
+
+    if (!g_replayPath.Value().empty())
+    {
+        return recording->OpenForReplay(g_replayPath.Value()) ? std::move(recording) : nullptr;
+    }
+    else if (!g_recordPath.Value().empty())
+    {
+        return recording->OpenForRecording(g_recordPath.Value()) ? std::move(recording) : nullptr;
+    }
+
+    return nullptr;
+}
+
+bool SimulationRecording::OpenForRecording(const std::string& recordingPath)
+{
+    path = recordingPath;
+    output.open(path, std::ios::binary | std::ios::trunc);
+    if (!output)
+    {
+        std::cout << "Failed to open " << path << " for recording" << std::endl;
+        return false;
+    }
+
+    Write(RecordingMagic);
+    Write(static_cast<int32_t>(g_simulationSeed.Value()));
+
+    return true;
+}
+
+bool SimulationRecording::OpenForReplay(const std::string& recordingPath)
+{
+    path = recordingPath;
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+    {
+        std::cout << "Failed to open recording " << path << std::endl;
+        return false;
+    }
+
+    replayData.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    replaying = true;
+
+    uint32_t magic;
+    int32_t seed;
+    if (!TryRead(magic) || magic != RecordingMagic || !TryRead(seed))
+    {
+        std::cout << path << " is not a simulation recording" << std::endl;
+        return false;
+    }
+
+    if (seed != g_simulationSeed.Value())
+    {
+        std::cout << "Warning: " << path << " was recorded with sim-seed " << seed << ", replay won't match" << std::endl;
+    }
+
+    return true;
+}
+
+void SimulationRecording::Record(uint64_t step, int playerEntityId, const TrainingLabel& decision)
+{
+    Write(RecordType::Decision);
+    Write(step);
+    Write(static_cast<int32_t>(playerEntityId));
+    Write(static_cast<int32_t>(decision.actionIndex));
+    Write(decision.moveCoord.x);
+    Write(decision.moveCoord.y);
+    Write(static_cast<int32_t>(decision.entityChoice));
+}
+
+void SimulationRecording::Record(uint64_t step, const RecordedMouse& mouse)
+{
+    Write(RecordType::Mouse);
+    Write(step);
+    Write(static_cast<uint8_t>((mouse.leftPressed ? 1 : 0) | (mouse.rightPressed ? 2 : 0)));
+    Write(mouse.worldPosition.x);
+    Write(mouse.worldPosition.y);
+}
+
+void SimulationRecording::Replay(
+    uint64_t step,
+    const std::function<void(int playerEntityId, const TrainingLabel& decision)>& applyDecision,
+    const std::function<void(const RecordedMouse& mouse)>& applyMouse)
+{
+    while (!diverged)
+    {
+        size_t recordStart = replayOffset;
+        RecordType type;
+        uint64_t recordedStep;
+        if (!TryRead(type) || !TryRead(recordedStep))
+        {
+            Diverge("Reached the end of the recording, the rest of the run is not replayed");
+            return;
+        }
+
+        if (recordedStep > step)
+        {
+            // Belongs to a later step
+            replayOffset = recordStart;
+            return;
+        }
+
+        if (recordedStep < step)
+        {
+            Diverge("Replay skipped a step");
+            return;
+        }
+
+        if (type == RecordType::Decision)
+        {
+            int32_t playerEntityId, actionIndex, entityChoice;
+            float moveX, moveY;
+            if (!TryRead(playerEntityId) || !TryRead(actionIndex) || !TryRead(moveX) || !TryRead(moveY)
+                || !TryRead(entityChoice))
+            {
+                Diverge("Recording is truncated");
+                return;
+            }
+
+            TrainingLabel decision;
+            decision.actionIndex = actionIndex;
+            decision.moveCoord = Vector2(moveX, moveY);
+            decision.entityChoice = entityChoice;
+            applyDecision(playerEntityId, decision);
+        }
+        else if (type == RecordType::Mouse)
+        {
+            uint8_t buttons;
+            float x, y;
+            if (!TryRead(buttons) || !TryRead(x) || !TryRead(y))
+            {
+                Diverge("Recording is truncated");
+                return;
+            }
+
+            RecordedMouse mouse;
+            mouse.leftPressed = (buttons & 1) != 0;
+            mouse.rightPressed = (buttons & 2) != 0;
+            mouse.worldPosition = Vector2(x, y);
+            applyMouse(mouse);
+        }
+        else
+        {
+            Diverge("Unknown record type");
+            return;
+        }
+    }
+}
+
+template<typename T>
+void SimulationRecording::Write(const T& value)
+{
+    output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool SimulationRecording::TryRead(T& value)
+{
+    if (replayOffset + sizeof(T) > replayData.size())
+    {
+        return false;
+    }
+
+    std::memcpy(&value, replayData.data() + replayOffset, sizeof(T));
+    replayOffset += sizeof(T);
+
+    return true;
+}
+
+void SimulationRecording::Diverge(const char* reason)
+{
+    std::cout << reason << ": " << path << " at byte " << replayOffset << std::endl;
+    diverged = true;
+}
+
+uint32_t GetSimulationSeed()
+{
+    return static_cast<uint32_t>(g_simulationSeed.Value());
+}
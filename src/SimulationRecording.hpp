@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Math/Vector2.hpp"
+
+struct TrainingLabel;
+
+// Mouse state for one update, with the position already in world space
+struct RecordedMouse
+{
+    bool leftPressed = false;
+    bool rightPressed = false;
+    Vector2 worldPosition;
+};
+
+// Everything outside the simulation that changes what it does: player decisions and mouse input, in the order the game
+// applied them. Each record carries the number of fixed steps that had run when it was applied, and a replay applies it
+// right before the next one, so the simulation sees the same input on the same step however frames or decision
+// workers happened to be timed. Recording a run and replaying it with the same seed repeats the exact same work.
+class SimulationRecording
+{
+public:
+    // Opens a recording from the sim-record / sim-replay console variables, or returns null if neither is set
+    static std::unique_ptr<SimulationRecording> CreateFromConsoleVars();
+
+    bool IsReplaying() const { return replaying; }
+
+    // Stores input applied after `step` fixed steps. The player is identified by its entity id.
+    void Record(uint64_t step, int playerEntityId, const TrainingLabel& decision);
+    void Record(uint64_t step, const RecordedMouse& mouse);
+
+    // Applies every record stored after `step` fixed steps, in recorded order
+    void Replay(
+        uint64_t step,
+        const std::function<void(int playerEntityId, const TrainingLabel& decision)>& applyDecision,
+        const std::function<void(const RecordedMouse& mouse)>& applyMouse);
+
+private:
+    enum class RecordType : uint8_t { Decision, Mouse };
+
+    bool OpenForRecording(const std::string& path);
+    bool OpenForReplay(const std::string& path);
+
+    template<typename T>
+    void Write(const T& value);
+
+    template<typename T>
+    bool TryRead(T& value);
+
+    void Diverge(const char* reason);
+
+    std::string path;
+    bool replaying = false;
+    bool diverged = false;
+    std::ofstream output;
+    std::vector<char> replayData;
+    size_t replayOffset = 0;
+};
+
+// The sim-seed console variable, or 0 when runs aren't seeded
+uint32_t GetSimulationSeed();
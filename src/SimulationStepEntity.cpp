@@ -0,0 +1,39 @@
+#include "SimulationStepEntity.hpp"
+#include "SpatialHashService.hpp"
+#include "RespawnService.hpp"
+#include "TowerSystem.hpp"
+#include "MinionSystem.hpp"
+#include "GameMetrics.hpp"
+#include "InputService.hpp"
+
+void SimulationStepEntity::FixedUpdate(float deltaTime)
+{
+    EndStepTiming();
+    _stepStart = std::chrono::steady_clock::now();
+
+    // Input applied between the previous step and this one, at the same point it was applied while recording
+    if (inputService != nullptr)
+    {
+        inputService->ReplayInputs(_stepIndex);
+    }
+    ++_stepIndex;
+
+    // Cells follow the positions of the last physics step, so fixed-step queries search the cells their targets are in
+    scene->GetService<SpatialHashService>()->Refresh();
+
+    scene->GetService<RespawnService>()->FixedUpdate(deltaTime);
+    scene->GetService<TowerSystem>()->FixedUpdate(deltaTime);
+    scene->GetService<MinionSystem>()->FixedUpdate(deltaTime);
+}
+
+void SimulationStepEntity::EndStepTiming()
+{
+    if (_stepStart == std::chrono::steady_clock::time_point())
+    {
+        return;
+    }
+
+    auto stepTime = std::chrono::steady_clock::now() - _stepStart;
+    g_gameMetrics.tickTime.Record(std::chrono::duration<float, std::micro>(stepTime).count());
+    _stepStart = std::chrono::steady_clock::time_point();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+
+#include "Scene/BaseEntity.hpp"
+
+struct InputService;
+
+// Scene services only see UpdateEvent, which runs at the frame rate. This entity is created before any other when the
+// scene loads and steps the services whose state has to advance with the fixed-timestep simulation.
+DEFINE_ENTITY(SimulationStepEntity, "simulation-step")
+{
+    void FixedUpdate(float deltaTime) override;
+
+    // Records the step that's running into the tick-time metric. The engine runs a frame's fixed steps back to back
+    // before its update, so a step ends where the next one starts, or at the update.
+    void EndStepTiming();
+
+    // Fixed steps run so far. Recorded input is tagged with it, see SimulationRecording.
+    uint64_t StepIndex() const { return _stepIndex; }
+
+    // Replays its recorded input at the start of each step. Not set in scenes without one.
+    InputService* inputService = nullptr;
+
+private:
+    std::chrono::steady_clock::time_point _stepStart;
+    uint64_t _stepIndex = 0;
+};
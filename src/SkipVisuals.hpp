@@ -0,0 +1,5 @@
+#pragma once
+
+// Set by --no-visuals. Entities skip their sprites and lights, which saves their setup and rendering in long training
+// runs. Everything else still runs as usual: the window, renderer and input, and the scene is stepped in real time.
+inline bool g_skipVisuals = false;
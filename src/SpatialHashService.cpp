@@ -0,0 +1,141 @@
+#include "SpatialHashService.hpp"
+
+void SpatialHashService::Add(Entity* entity)
+{
+    Entry entry;
+    entry.entity = entity;
+    entry.layer = GetOrCreateLayer(entity->type, TeamOf(entity));
+    entry.cell = CellKey(CellCoordinate(entity->Center().x), CellCoordinate(entity->Center().y));
+    entry.position = entity->Center();
+
+    Insert(entity, entry);
+    entryIndices[entity] = entries.size();
+    entries.push_back(entry);
+}
+
+void SpatialHashService::Remove(Entity* entity)
+{
+    auto index = entryIndices.find(entity);
+    if (index == entryIndices.end())
+    {
+        return;
+    }
+
+    Erase(entity, entries[index->second]);
+
+    entries[index->second] = entries.back();
+    entryIndices[entries[index->second].entity] = index->second;
+    entries.pop_back();
+    entryIndices.erase(index);
+}
+
+void SpatialHashService::Refresh()
+{
+    // Most entities stay in their cell from one step to the next, so only the ones that moved out are relocated
+    float maxDisplacementSquared = 0;
+    for (Entry& entry : entries)
+    {
+        maxDisplacementSquared = std::max(maxDisplacementSquared, Refile(entry));
+    }
+
+    maxDisplacement = std::sqrt(maxDisplacementSquared);
+}
+
+void SpatialHashService::Update(Entity* entity)
+{
+    auto index = entryIndices.find(entity);
+    if (index != entryIndices.end())
+    {
+        Refile(entries[index->second]);
+    }
+}
+
+float SpatialHashService::Refile(Entry& entry)
+{
+    Entity* entity = entry.entity;
+    Vector2 position = entity->Center();
+    Vector2 displacement = position - entry.position;
+    entry.position = position;
+
+    int team = TeamOf(entity);
+    int64_t cell = CellKey(CellCoordinate(position.x), CellCoordinate(position.y));
+
+    if (cell != entry.cell || team != entry.layer->team)
+    {
+        Erase(entity, entry);
+        entry.layer = GetOrCreateLayer(entity->type, team);
+        entry.cell = cell;
+        Insert(entity, entry);
+    }
+
+    return displacement.Dot(displacement);
+}
+
+int SpatialHashService::TeamOf(Entity* entity)
+{
+    TeamComponent* team;
+    return entity->TryGetComponent(team) ? team->teamId : TeamFilter::NoTeam;
+}
+
+SpatialHashService::Layer* SpatialHashService::GetOrCreateLayer(StringId type, int team)
+{
+    for (auto& layer : layers)
+    {
+        if (layer->type == type && layer->team == team)
+        {
+            return layer.get();
+        }
+    }
+
+    auto layer = std::make_unique<Layer>();
+    layer->type = type;
+    layer->team = team;
+    layers.push_back(std::move(layer));
+
+    return layers.back().get();
+}
+
+void SpatialHashService::Insert(Entity* entity, Entry& entry)
+{
+    Layer* layer = entry.layer;
+    layer->cells[entry.cell].push_back(entity);
+
+    int x = static_cast<int>(entry.cell >> 32);
+    int y = static_cast<int32_t>(entry.cell & 0xFFFFFFFF);
+    layer->minX = std::min(layer->minX, x);
+    layer->minY = std::min(layer->minY, y);
+    layer->maxX = std::max(layer->maxX, x);
+    layer->maxY = std::max(layer->maxY, y);
+}
+
+void SpatialHashService::Erase(Entity* entity, const Entry& entry)
+{
+    auto cell = entry.layer->cells.find(entry.cell);
+    if (cell == entry.layer->cells.end())
+    {
+        return;
+    }
+
+    auto& cellEntities = cell->second;
+    auto position = std::find(cellEntities.begin(), cellEntities.end(), entity);
+    if (position != cellEntities.end())
+    {
+        *position = cellEntities.back();
+        cellEntities.pop_back();
+    }
+
+    if (cellEntities.empty())
+    {
+        entry.layer->cells.erase(cell);
+    }
+}
+
+void SpatialIndexComponent::OnAdded()
+{
+    GetScene()->GetService<SpatialHashService>()->Add(owner);
+}
+
+void SpatialIndexComponent::OnRemoved()
+{
+    GetScene()->GetService<SpatialHashService>()->Remove(owner);
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "Scene/Scene.hpp"
+#include "Scene/EntityComponent.hpp"
+#include "TeamComponent.hpp"
+#include "TopKSelector.hpp"
+
+// Which teams a spatial query accepts. Entities without a TeamComponent only match Any().
+struct TeamFilter
+{
+    static constexpr int AnyTeam = INT_MIN;
+    static constexpr int NoTeam = INT_MIN + 1;
+
+    static TeamFilter Any() { return { AnyTeam, false }; }
+    static TeamFilter Only(int team) { return { team, false }; }
+    static TeamFilter EnemiesOf(int team) { return { team, true }; }
+
+    bool Matches(int entityTeam) const
+    {
+        if (team == AnyTeam) return true;
+        if (entityTeam == NoTeam) return false;
+        return excludeTeam ? entityTeam != team : entityTeam == team;
+    }
+
+    int team;
+    bool excludeTeam;
+};
+
+// Uniform grid of the entities that have a SpatialIndexComponent, kept per entity type and team, so that nearest,
+// k-nearest and radius queries only look at the cells around the query instead of every entity of the type. Cells are
+// refreshed from entity positions and teams once per fixed step by the SimulationStepEntity; distances are always
+// measured to the live positions.
+class SpatialHashService : public ISceneService
+{
+public:
+    static constexpr float CellSize = 256.0f;
+
+    void Add(Entity* entity);
+    void Remove(Entity* entity);
+    void Refresh();
+
+    // Re-files an entity right away, for changes the search bounds can't allow for until the next Refresh: a new team,
+    // or a position set directly instead of moved by physics. Does nothing for entities that aren't indexed.
+    void Update(Entity* entity);
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+    // Returns the nearest matching entity and its distance, or null and infinity if there's none within maxDistance
+    template<typename TEntity>
+    std::tuple<TEntity*, float> FindNearest(Vector2 position, TeamFilter filter, float maxDistance = std::numeric_limits<float>::infinity());
+
+    // Offers the nearest matching entities to the selector, scored by squared distance times scoreScale
+    template<typename TEntity, typename TCandidate, int K>
+    void FindKNearest(Vector2 position, TeamFilter filter, TopKSelector<TCandidate, K>& selector, float scoreScale = 1.0f);
+
+    template<typename TEntity, typename TVisit>
+    void ForEachInRadius(Vector2 position, float radius, TeamFilter filter, TVisit visit);
+
+private:
+    struct Layer
+    {
+        StringId type;
+        int team;
+        std::unordered_map<int64_t, std::vector<Entity*>> cells;
+
+        // Grows but never shrinks, it only bounds how far a search has to go
+        int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    };
+
+    struct Entry
+    {
+        Entity* entity;
+        Layer* layer;
+        int64_t cell;
+        Vector2 position;
+    };
+
+    static int CellCoordinate(float worldCoordinate) { return static_cast<int>(std::floor(worldCoordinate / CellSize)); }
+    static int64_t CellKey(int x, int y) { return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(y); }
+    static int TeamOf(Entity* entity);
+
+    Layer* GetOrCreateLayer(StringId type, int team);
+    void Insert(Entity* entity, Entry& entry);
+    void Erase(Entity* entity, const Entry& entry);
+
+    // Moves the entry to its entity's current cell and team, returning the squared distance the entity moved since it
+    // was last filed
+    float Refile(Entry& entry);
+
+    // Visits matching cells ring by ring outwards from the query's cell. After each ring, stopAfterRing gets the least
+    // distance any entity in the remaining rings can be at, and returns true to end the search. That distance allows for
+    // entities having moved since the last refresh by as much as the farthest one moved between the last two.
+    template<typename TVisitEntity, typename TStopAfterRing>
+    void SearchRings(Vector2 position, StringId type, TeamFilter filter, TVisitEntity visitEntity, TStopAfterRing stopAfterRing);
+
+    std::vector<std::unique_ptr<Layer>> layers;
+    // Kept in the order entities were added, so cells fill in the same order on every run with the same seed and
+    // queries break distance ties the same way. Walking a map keyed by pointer would make that order depend on the allocator.
+    std::vector<Entry> entries;
+    std::unordered_map<Entity*, size_t> entryIndices;
+    float maxDisplacement = 0;
+};
+
+// Keeps its owner in the scene's SpatialHashService for as long as it exists
+DEFINE_COMPONENT(SpatialIndexComponent)
+{
+    void OnAdded() override;
+    void OnRemoved() override;
+};
+
+template<typename TVisitEntity, typename TStopAfterRing>
+void SpatialHashService::SearchRings(Vector2 position, StringId type, TeamFilter filter, TVisitEntity visitEntity, TStopAfterRing stopAfterRing)
+{
+    // Shared by the searches on a thread. Each one only uses the layers it appended, so a visit can start another search.
+    thread_local std::vector<Layer*> matching;
+    size_t firstMatching = matching.size();
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+
+    for (auto& layer : layers)
+    {
+        if (layer->type == type && filter.Matches(layer->team) && !layer->cells.empty())
+        {
+            matching.push_back(layer.get());
+            minX = std::min(minX, layer->minX);
+            minY = std::min(minY, layer->minY);
+            maxX = std::max(maxX, layer->maxX);
+            maxY = std::max(maxY, layer->maxY);
+        }
+    }
+
+    size_t endMatching = matching.size();
+    if (endMatching == firstMatching)
+    {
+        return;
+    }
+
+    int centerX = CellCoordinate(position.x);
+    int centerY = CellCoordinate(position.y);
+    int lastRing = std::max(std::max(centerX - minX, maxX - centerX), std::max(centerY - minY, maxY - centerY));
+
+    auto visitCell = [&](int x, int y)
+    {
+        if (x < minX || x > maxX || y < minY || y > maxY)
+        {
+            return;
+        }
+
+        int64_t key = CellKey(x, y);
+        for (size_t i = firstMatching; i < endMatching; ++i)
+        {
+            auto cell = matching[i]->cells.find(key);
+            if (cell != matching[i]->cells.end())
+            {
+                for (Entity* entity : cell->second)
+                {
+                    visitEntity(entity);
+                }
+            }
+        }
+    };
+
+    for (int ring = 0; ring <= lastRing; ++ring)
+    {
+        if (ring == 0)
+        {
+            visitCell(centerX, centerY);
+        }
+        else
+        {
+            for (int dx = -ring; dx <= ring; ++dx)
+            {
+                visitCell(centerX + dx, centerY - ring);
+                visitCell(centerX + dx, centerY + ring);
+            }
+
+            for (int dy = -ring + 1; dy <= ring - 1; ++dy)
+            {
+                visitCell(centerX - ring, centerY + dy);
+                visitCell(centerX + ring, centerY + dy);
+            }
+        }
+
+        // The query point is somewhere inside the center cell, so the next ring is at least this far away
+        if (stopAfterRing(std::max(ring * CellSize - maxDisplacement, 0.0f)))
+        {
+            break;
+        }
+    }
+
+    matching.resize(firstMatching);
+}
+
+template<typename TEntity>
+std::tuple<TEntity*, float> SpatialHashService::FindNearest(Vector2 position, TeamFilter filter, float maxDistance)
+{
+    TEntity* nearest = nullptr;
+    float nearestDistanceSquared = maxDistance * maxDistance;
+
+    SearchRings(position, TEntity::Type, filter,
+        [&](Entity* entity)
+        {
+            Vector2 offset = entity->Center() - position;
+            float distanceSquared = offset.Dot(offset);
+            if (distanceSquared < nearestDistanceSquared)
+            {
+                nearest = static_cast<TEntity*>(entity);
+                nearestDistanceSquared = distanceSquared;
+            }
+        },
+        [&](float remainingDistance)
+        {
+            return remainingDistance * remainingDistance >= nearestDistanceSquared;
+        });
+
+    return std::make_tuple(nearest, nearest != nullptr ? std::sqrt(nearestDistanceSquared) : std::numeric_limits<float>::infinity());
+}
+
+template<typename TEntity, typename TCandidate, int K>
+void SpatialHashService::FindKNearest(Vector2 position, TeamFilter filter, TopKSelector<TCandidate, K>& selector, float scoreScale)
+{
+    SearchRings(position, TEntity::Type, filter,
+        [&](Entity* entity)
+        {
+            Vector2 offset = entity->Center() - position;
+            selector.Offer(offset.Dot(offset) * scoreScale, static_cast<TEntity*>(entity));
+        },
+        [&](float remainingDistance)
+        {
+            return selector.Size() == K && remainingDistance * remainingDistance * scoreScale >= selector.WorstScore();
+        });
+}
+
+template<typename TEntity, typename TVisit>
+void SpatialHashService::ForEachInRadius(Vector2 position, float radius, TeamFilter filter, TVisit visit)
+{
+    float radiusSquared = radius * radius;
+
+    SearchRings(position, TEntity::Type, filter,
+        [&](Entity* entity)
+        {
+            Vector2 offset = entity->Center() - position;
+            if (offset.Dot(offset) <= radiusSquared)
+            {
+                visit(static_cast<TEntity*>(entity));
+            }
+        },
+        [&](float remainingDistance)
+        {
+            return remainingDistance > radius;
+        });
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Keeps the last recencyWindow samples received in a ring, the only copy of them, and for each group the arrival
+// numbers of its samples that are still in the ring, at most groupCapacity of them. Whole batches are drawn by picking
+// each sample's group by weight and then a uniformly random sample within it. Adding and drawing a sample are both
+// O(1) amortized, however large or imbalanced the groups get.
+template<typename TSample, int GroupCount>
+class StratifiedSampler
+{
+public:
+    StratifiedSampler(int groupCapacity, int recencyWindow)
+        : _groupCapacity(groupCapacity),
+        _recent(recencyWindow)
+    {
+        for (auto& weight : _weights)
+        {
+            weight = 1.0f;
+        }
+    }
+
+    void Seed(uint32_t seed)
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _random.seed(seed);
+    }
+
+    // Weights are read by every draw without the lock
+    float Weight(int group) const { return _weights[group].load(std::memory_order_relaxed); }
+    void SetWeight(int group, float weight) { _weights[group].store(std::max(weight, 0.0f), std::memory_order_relaxed); }
+
+    int GroupSize(int group)
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        return static_cast<int>(_arrivals[group].size());
+    }
+
+    // Samples age out in the order they arrived, so every group only has to be trimmed from its front
+    void Add(int group, const TSample& sample)
+    {
+        if (group < 0 || group >= GroupCount)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(_mutex);
+        uint64_t arrival = _received++;
+        _recent[arrival % _recent.size()] = sample;
+
+        std::deque<uint64_t>& arrivals = _arrivals[group];
+        arrivals.push_back(arrival);
+        if (arrivals.size() > _groupCapacity)
+        {
+            arrivals.pop_front();
+        }
+
+        // The slot just written held the sample that arrived a whole window ago
+        for (auto& other : _arrivals)
+        {
+            while (!other.empty() && other.front() + _recent.size() <= arrival)
+            {
+                other.pop_front();
+            }
+        }
+    }
+
+    // Fills the whole batch under a single lock. Empty groups are skipped and their weight goes to the others.
+    bool TryDrawBatch(TSample* outBatch, int batchSize)
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+
+        float cumulativeWeight[GroupCount];
+        if (!AccumulateWeights(1, cumulativeWeight))
+        {
+            return false;
+        }
+
+        for (int i = 0; i < batchSize; ++i)
+        {
+            const std::deque<uint64_t>& arrivals = _arrivals[PickGroup(cumulativeWeight, 1)];
+            std::uniform_int_distribution<size_t> pickSample(0, arrivals.size() - 1);
+            outBatch[i] = _recent[arrivals[pickSample(_random)] % _recent.size()];
+        }
+
+        return true;
+    }
+
+    // Consecutive samples of one group, the group picked by weight among those with enough samples
+    bool TryDrawSequence(TSample* outSequence, int length)
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+
+        float cumulativeWeight[GroupCount];
+        if (!AccumulateWeights(length, cumulativeWeight))
+        {
+            return false;
+        }
+
+        const std::deque<uint64_t>& arrivals = _arrivals[PickGroup(cumulativeWeight, length)];
+        std::uniform_int_distribution<size_t> pickFirst(0, arrivals.size() - length);
+        size_t first = pickFirst(_random);
+
+        for (int i = 0; i < length; ++i)
+        {
+            outSequence[i] = _recent[arrivals[first + i] % _recent.size()];
+        }
+
+        return true;
+    }
+
+private:
+    bool IsEligible(int group, size_t minSize) const { return _arrivals[group].size() >= minSize; }
+
+    bool AccumulateWeights(size_t minSize, float (&cumulativeWeight)[GroupCount]) const
+    {
+        float totalWeight = 0;
+        for (int i = 0; i < GroupCount; ++i)
+        {
+            totalWeight += IsEligible(i, minSize) ? Weight(i) : 0.0f;
+            cumulativeWeight[i] = totalWeight;
+        }
+
+        return totalWeight > 0;
+    }
+
+    int PickGroup(const float (&cumulativeWeight)[GroupCount], size_t minSize)
+    {
+        std::uniform_real_distribution<float> pickWeight(0.0f, cumulativeWeight[GroupCount - 1]);
+        float weight = pickWeight(_random);
+
+        int group = 0;
+        while (group < GroupCount - 1 && (weight >= cumulativeWeight[group] || !IsEligible(group, minSize)))
+        {
+            ++group;
+        }
+
+        // Rounding can leave the pick past the last eligible group
+        while (!IsEligible(group, minSize))
+        {
+            --group;
+        }
+
+        return group;
+    }
+
+    std::mutex _mutex;
+    size_t _groupCapacity;
+    std::vector<TSample> _recent;
+    std::deque<uint64_t> _arrivals[GroupCount];
+    std::atomic<float> _weights[GroupCount];
+    uint64_t _received = 0;
+    std::minstd_rand _random;
+};
@@ -1 +1,29 @@
-#include "TeamComponent.hpp"
\ No newline at end of file
+#include "TeamComponent.hpp"
+#include "TeamRegistryService.hpp"
+#include "SpatialHashService.hpp"
+
+void TeamComponent::OnAdded()
+{
+    GetScene()->GetService<TeamRegistryService>()->Add(this);
+}
+
+void TeamComponent::OnRemoved()
+{
+    GetScene()->GetService<TeamRegistryService>()->Remove(this);
+}
+
+void TeamComponent::SetTeam(int team)
+{
+    if (team == teamId)
+    {
+        return;
+    }
+
+    auto registry = GetScene()->GetService<TeamRegistryService>();
+    registry->Remove(this);
+    teamId = team;
+    registry->Add(this);
+
+    // Entities are usually given their team after they're created, which has already filed them under the old one
+    GetScene()->GetService<SpatialHashService>()->Update(owner);
+}
@@ -2,7 +2,19 @@
 
 #include "Scene/EntityComponent.hpp"
 
+// Team ids are read directly but must be changed through SetTeam, which keeps the TeamRegistryService and the
+// SpatialHashService up to date
 DEFINE_COMPONENT(TeamComponent)
 {
-	int teamId;
-};
\ No newline at end of file
+    void OnAdded() override;
+    void OnRemoved() override;
+    void SetTeam(int team);
+
+    int teamId = -1;
+
+private:
+    friend class TeamRegistryService;
+
+    struct TeamRegistryLayer* _registryLayer = nullptr;
+    int _registrySlot = -1;
+};
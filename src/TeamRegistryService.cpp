@@ -0,0 +1,47 @@
+#include "TeamRegistryService.hpp"
+
+void TeamRegistryService::Add(TeamComponent* member)
+{
+    auto layer = FindLayer(member->owner->type, member->teamId);
+    if (layer == nullptr)
+    {
+        layers.push_back(std::make_unique<TeamRegistryLayer>());
+        layer = layers.back().get();
+        layer->type = member->owner->type;
+        layer->team = member->teamId;
+    }
+
+    member->_registryLayer = layer;
+    member->_registrySlot = static_cast<int>(layer->members.size());
+    layer->members.push_back(member);
+}
+
+void TeamRegistryService::Remove(TeamComponent* member)
+{
+    auto layer = member->_registryLayer;
+    if (layer == nullptr)
+    {
+        return;
+    }
+
+    auto last = layer->members.back();
+    layer->members[member->_registrySlot] = last;
+    last->_registrySlot = member->_registrySlot;
+    layer->members.pop_back();
+
+    member->_registryLayer = nullptr;
+    member->_registrySlot = -1;
+}
+
+TeamRegistryLayer* TeamRegistryService::FindLayer(StringId type, int team)
+{
+    for (auto& layer : layers)
+    {
+        if (layer->type == type && layer->team == team)
+        {
+            return layer.get();
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Scene/Scene.hpp"
+#include "TeamComponent.hpp"
+
+// Entities of one type on one team. Members are unordered, removal swaps the last member into the freed slot.
+struct TeamRegistryLayer
+{
+    StringId type;
+    int team;
+    std::vector<TeamComponent*> members;
+};
+
+// Every entity with a TeamComponent, indexed by entity type and team. Adding, removing, changing team and counting only
+// look through the handful of (type, team) layers, so code that needs "the castles of team 1" or "how many players team 0
+// has" doesn't have to walk every entity of the type.
+class TeamRegistryService : public ISceneService
+{
+public:
+    void Add(TeamComponent* member);
+    void Remove(TeamComponent* member);
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+    template<typename TEntity>
+    int Count(int team);
+
+    template<typename TEntity>
+    int CountAllTeams();
+
+    // The visitor may destroy the entity it's given, but must not add entities of the same type and team
+    template<typename TEntity, typename TVisit>
+    void ForEach(int team, TVisit visit);
+
+private:
+    TeamRegistryLayer* FindLayer(StringId type, int team);
+
+    // Layers are never removed so that members can keep pointers to theirs
+    std::vector<std::unique_ptr<TeamRegistryLayer>> layers;
+};
+
+template<typename TEntity>
+int TeamRegistryService::Count(int team)
+{
+    auto layer = FindLayer(TEntity::Type, team);
+    return layer != nullptr ? static_cast<int>(layer->members.size()) : 0;
+}
+
+template<typename TEntity>
+int TeamRegistryService::CountAllTeams()
+{
+    int count = 0;
+    for (auto& layer : layers)
+    {
+        if (layer->type == TEntity::Type)
+        {
+            count += static_cast<int>(layer->members.size());
+        }
+    }
+
+    return count;
+}
+
+template<typename TEntity, typename TVisit>
+void TeamRegistryService::ForEach(int team, TVisit visit)
+{
+    auto layer = FindLayer(TEntity::Type, team);
+    if (layer == nullptr)
+    {
+        return;
+    }
+
+    // Walking backwards keeps this safe when the visited member is swap-removed
+    for (int i = static_cast<int>(layer->members.size()) - 1; i >= 0; --i)
+    {
+        if (i < static_cast<int>(layer->members.size()))
+        {
+            visit(static_cast<TEntity*>(layer->members[i]->owner));
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+
+// Keeps the K lowest-scoring candidates offered to it in a bounded max-heap, so selecting from N candidates costs
+// O(N log K) time and no allocations regardless of N.
+template<typename TCandidate, int K>
+class TopKSelector
+{
+public:
+    struct Entry
+    {
+        float score;
+        TCandidate candidate;
+    };
+
+    void Offer(float score, const TCandidate& candidate)
+    {
+        if (_count < K)
+        {
+            _entries[_count++] = { score, candidate };
+            std::push_heap(_entries, _entries + _count, CompareScores);
+        }
+        else if (score < _entries[0].score)
+        {
+            std::pop_heap(_entries, _entries + K, CompareScores);
+            _entries[K - 1] = { score, candidate };
+            std::push_heap(_entries, _entries + K, CompareScores);
+        }
+    }
+
+    // Orders the selected candidates from lowest to highest score. No more candidates can be offered afterwards.
+    const Entry* SortAndBegin()
+    {
+        std::sort_heap(_entries, _entries + _count, CompareScores);
+        return _entries;
+    }
+
+    const Entry* End() const { return _entries + _count; }
+    int Size() const { return _count; }
+
+    // Highest score currently kept, only meaningful once something has been offered
+    float WorstScore() const { return _entries[0].score; }
+
+private:
+    static bool CompareScores(const Entry& lhs, const Entry& rhs)
+    {
+        return lhs.score < rhs.score;
+    }
+
+    Entry _entries[K];
+    int _count = 0;
+};
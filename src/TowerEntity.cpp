@@ -1,7 +1,9 @@
 #include "TowerEntity.hpp"
+#include "Profiler.hpp"
 
 #include "Engine.hpp"
 #include "PlayerEntity.hpp"
+#include "MinionEntity.hpp"
 #include "FireballEntity.hpp"
 #include "CastleEntity.hpp"
 #include "ObstacleComponent.hpp"
@@ -9,6 +11,11 @@
 #include "Components/SpriteComponent.hpp"
 #include "Physics/PathFinding.hpp"
 #include "Net/ReplicationManager.hpp"
+#include "SkipVisuals.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamRegistryService.hpp"
+#include "TeamComponent.hpp"
+#include "TowerSystem.hpp"
 
 void TowerEntity::DoSerialize(EntitySerializer& serializer)
 {
@@ -17,8 +24,11 @@ void TowerEntity::DoSerialize(EntitySerializer& serializer)
 
 void TowerEntity::OnAdded()
 {
-    spriteComponent = AddComponent<SpriteComponent>("towerSprite");
-    spriteComponent->scale = Vector2(5.0f);
+    if (!g_skipVisuals)
+    {
+        spriteComponent = AddComponent<SpriteComponent>("towerSprite");
+        spriteComponent->scale = Vector2(5.0f);
+    }
 
     Vector2 size{ 11 * 5, 32 * 5 };
     SetDimensions(size);
@@ -33,41 +43,56 @@ void TowerEntity::OnAdded()
     health->health = 500;
 
     team = AddComponent<TeamComponent>();
+    AddComponent<SpatialIndexComponent>();
 
     auto offset = size / 2 + Vector2(40, 40);
 
-    _light = AddComponent<LightComponent<PointLight>>();
-    _light->position = Center();
-    _light->intensity = 0.5;
-    _light->maxDistance = 500;
-    _light->maxDistance = 500;
+    if (!g_skipVisuals)
+    {
+        _light = AddComponent<LightComponent<PointLight>>();
+        _light->position = Center();
+        _light->intensity = 0.5;
+        _light->maxDistance = 500;
+        _light->maxDistance = 500;
+    }
 
     region = rigidBody->CreateCircleCollider(reach, true);
+
+    scene->GetService<TowerSystem>()->Add(this);
 }
 
-void TowerEntity::Update(float deltaTime)
+void TowerEntity::SetPlayerId(int id)
 {
-    _light->color = playerId == 0
-        ? Color::Green()
-        : Color::White();
+    playerId = id;
 
-    if (_currentTarget.IsValid())
+    if (_light != nullptr)
     {
-        _fireballTimeout -= deltaTime;
+        _light->color = playerId == 0
+            ? Color::Green()
+            : Color::White();
     }
-
-    OnUpdateState();
 }
 
 void TowerEntity::OnDestroyed()
 {
-    for (auto base : scene->GetEntitiesOfType<CastleEntity>())
+    scene->GetService<TowerSystem>()->Remove(this);
+
+    scene->GetService<TeamRegistryService>()->ForEach<CastleEntity>(team->teamId, [](CastleEntity* base)
+    {
+        base->SendEvent(TowerDestroyedEvent());
+    });
+}
+
+// Only bodies the TowerSystem would target are counted, so friendly and neutral bodies in reach don't start searches
+static bool EntityIsPotentialTarget(TeamComponent* towerTeam, Entity* entity)
+{
+    TeamComponent* entityTeam;
+    if (!entity->TryGetComponent(entityTeam))
     {
-        if (base->team->teamId == team->teamId)
-        {
-            base->SendEvent(TowerDestroyedEvent());
-        }
+        return false;
     }
+
+    return towerTeam->teamId != entityTeam->teamId && (entity->Is<PlayerEntity>() || entity->Is<MinionEntity>());
 }
 
 void TowerEntity::ReceiveEvent(const IEntityEvent& ev)
@@ -78,132 +103,24 @@ void TowerEntity::ReceiveEvent(const IEntityEvent& ev)
     }
     else if (auto damageDealtEvent = ev.Is<DamageDealtEvent>())
     {
-        Entity* currentTarget = nullptr;
-        if (_currentTarget.TryGetValue(currentTarget))
-        {
-            if (currentTarget != damageDealtEvent->dealer)
-            {
-                ChangeState(
-                    { TowerEntityAiState::AttackSelectedTarget,
-                     EntityReference<Entity>(damageDealtEvent->dealer) });
-            }
-        }
+        scene->GetService<TowerSystem>()->Retarget(this, damageDealtEvent->dealer);
     }
     else if (auto contactBeginEvent = ev.Is<ContactBeginEvent>())
     {
-        if (contactBeginEvent->OtherIs<FireballEntity>())
+        auto other = contactBeginEvent->other;
+        if (contactBeginEvent->self.GetFixture() == region && !other.IsTrigger() && EntityIsPotentialTarget(team, other.OwningEntity()))
         {
-            return;
-        }
-
-        if (contactBeginEvent->self.GetFixture() == region && !contactBeginEvent->other.IsTrigger())
-        {
-            _targets.PushBackUniqueIfRoom(contactBeginEvent->other.OwningEntity());
+            scene->GetService<TowerSystem>()->OnRegionEntered(this);
         }
     }
     else if (auto contactEndEvent = ev.Is<ContactEndEvent>())
     {
         auto other = contactEndEvent->other;
-        if (contactEndEvent->self.GetFixture() == region && !other.IsTrigger())
-        {
-            _targets.RemoveSingle(other.OwningEntity());
-        }
-    }
-}
-
-void TowerEntity::ChangeState(TowerEntityState state)
-{
-    OnExitState();
-    OnEnterState(state);
-
-    _state = state;
-}
-
-void TowerEntity::OnEnterState(TowerEntityState& newState)
-{
-    switch (newState.state)
-    {
-    case TowerEntityAiState::DoNothing:
-    case TowerEntityAiState::SearchForTarget:
-        break;
-    case TowerEntityAiState::AttackSelectedTarget:
-    {
-        _currentTarget = newState.newTarget;
-    }
-    break;
-    }
-}
-
-void TowerEntity::OnUpdateState()
-{
-    switch (_state.state)
-    {
-    case TowerEntityAiState::DoNothing:
-        ChangeState({ TowerEntityAiState::SearchForTarget });
-        break;
-    case TowerEntityAiState::SearchForTarget:
-    {
-        float closestTargetDistance = reach * 2;
-        Entity* closestTarget = nullptr;
-
-        for (auto& target : _targets)
-        {
-            if (target == nullptr || target->isDestroyed)
-            {
-                continue;
-            }
-
-            TeamComponent* teamComponent;
-            if (target->TryGetComponent(teamComponent)) {
-                if (teamComponent->teamId == team->teamId)
-                {
-                    continue;
-                }
-
-                if ((target->Center() - Center()).Length() <= closestTargetDistance)
-                {
-                    closestTarget = target;
-                }
-            }
-        }
-
-        if (closestTarget != nullptr)
+        if (contactEndEvent->self.GetFixture() == region && !other.IsTrigger() && EntityIsPotentialTarget(team, other.OwningEntity()))
         {
-            ChangeState({ TowerEntityAiState::AttackSelectedTarget, EntityReference<Entity>(closestTarget) });
+            scene->GetService<TowerSystem>()->OnRegionExited(this);
         }
     }
-    break;
-    case TowerEntityAiState::AttackSelectedTarget:
-    {
-        Entity* target = _currentTarget.GetValueOrNull();
-        if (target == nullptr || (target->Center() - Center()).Length() >= reach)
-        {
-            _currentTarget.Invalidate();
-            ChangeState({ TowerEntityAiState::SearchForTarget });
-        }
-        else if (_fireballTimeout <= 0)
-        {
-            _fireballTimeout = FireballTimeoutLength;
-            ShootFireball(target);
-        }
-    }
-    break;
-    }
-}
-
-void TowerEntity::OnExitState()
-{
-    switch (_state.state)
-    {
-    case TowerEntityAiState::DoNothing:
-    case TowerEntityAiState::SearchForTarget:
-        break;
-    case TowerEntityAiState::AttackSelectedTarget:
-    {
-        _currentTarget.Invalidate();
-    }
-    break;
-    }
 }
 
 void TowerEntity::ShootFireball(Entity* target)
@@ -10,14 +10,6 @@ struct CastleEntity;
 struct ObstacleComponent;
 struct TeamComponent;
 
-enum class TowerEntityAiState { DoNothing, SearchForTarget, AttackSelectedTarget };
-struct TowerEntityState
-{
-    TowerEntityAiState state;
-
-    EntityReference<Entity> newTarget = EntityReference<Entity>::Invalid();
-};
-
 DEFINE_EVENT(TowerDestroyedEvent)
 {
     TowerDestroyedEvent()
@@ -29,12 +21,11 @@ DEFINE_ENTITY(TowerEntity, "tower")
 {
     void OnAdded() override;
     void OnDestroyed() override;
-    void Update(float deltaTime) override;
 
     void ReceiveEvent(const IEntityEvent & ev) override;
     void DoSerialize(EntitySerializer & serializer) override;
 
-    void ChangeState(TowerEntityState state);
+    void SetPlayerId(int id);
 
     int playerId;
     float reach = 250.0f;
@@ -45,21 +36,15 @@ DEFINE_ENTITY(TowerEntity, "tower")
 
 private:
     float _colorChangeTime = 0;
-    SpriteComponent* spriteComponent;
-
-    LightComponent<PointLight>* _light;
-
-    EntityReference<Entity> _currentTarget;
-    FixedSizeVector<Entity*, 32> _targets;
+    SpriteComponent* spriteComponent = nullptr;
 
-    void OnEnterState(TowerEntityState & newState);
-    void OnUpdateState();
-    void OnExitState();
+    LightComponent<PointLight>* _light = nullptr;
 
-    TowerEntityState _state{ TowerEntityAiState::DoNothing };
+    // Targeting and cooldowns are run by the TowerSystem
+    friend class TowerSystem;
+    int _systemSlot = -1;
 
     void ShootFireball(Entity * target);
-    float _fireballTimeout = 0.75f;
 
     b2Fixture* region = nullptr;
 };
\ No newline at end of file
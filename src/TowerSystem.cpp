@@ -0,0 +1,176 @@
+#include "TowerSystem.hpp"
+
+#include <cmath>
+
+#include "TowerEntity.hpp"
+#include "PlayerEntity.hpp"
+#include "MinionEntity.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamComponent.hpp"
+#include "Profiler.hpp"
+
+void TowerSystem::Add(TowerEntity* tower)
+{
+    tower->_systemSlot = static_cast<int>(towers.size());
+
+    towers.push_back(tower);
+    positionX.push_back(tower->Center().x);
+    positionY.push_back(tower->Center().y);
+    reachSquared.push_back(tower->reach * tower->reach);
+    fireballTimeout.push_back(tower->FireballTimeoutLength);
+    bodiesInRegion.push_back(0);
+    targets.push_back(EntityReference<Entity>::Invalid());
+}
+
+void TowerSystem::Remove(TowerEntity* tower)
+{
+    int slot = tower->_systemSlot;
+    if (slot < 0)
+    {
+        return;
+    }
+
+    // Moves the last tower into the freed slot
+    int last = static_cast<int>(towers.size()) - 1;
+    towers[slot] = towers[last];
+    positionX[slot] = positionX[last];
+    positionY[slot] = positionY[last];
+    reachSquared[slot] = reachSquared[last];
+    fireballTimeout[slot] = fireballTimeout[last];
+    bodiesInRegion[slot] = bodiesInRegion[last];
+    targets[slot] = targets[last];
+    towers[slot]->_systemSlot = slot;
+
+    towers.pop_back();
+    positionX.pop_back();
+    positionY.pop_back();
+    reachSquared.pop_back();
+    fireballTimeout.pop_back();
+    bodiesInRegion.pop_back();
+    targets.pop_back();
+
+    tower->_systemSlot = -1;
+}
+
+void TowerSystem::OnRegionEntered(TowerEntity* tower)
+{
+    if (tower->_systemSlot >= 0)
+    {
+        ++bodiesInRegion[tower->_systemSlot];
+    }
+}
+
+void TowerSystem::OnRegionExited(TowerEntity* tower)
+{
+    if (tower->_systemSlot >= 0 && bodiesInRegion[tower->_systemSlot] > 0)
+    {
+        --bodiesInRegion[tower->_systemSlot];
+    }
+}
+
+void TowerSystem::Retarget(TowerEntity* tower, Entity* target)
+{
+    int slot = tower->_systemSlot;
+    if (slot < 0)
+    {
+        return;
+    }
+
+    Entity* currentTarget;
+    if (targets[slot].TryGetValue(currentTarget) && currentTarget != target)
+    {
+        targets[slot] = EntityReference<Entity>(target);
+    }
+}
+
+void TowerSystem::FixedUpdate(float deltaTime)
+{
+    PROFILE_ZONE("TowerSystem::FixedUpdate");
+
+    for (int slot = 0; slot < static_cast<int>(towers.size()); ++slot)
+    {
+        Entity* target;
+        if (targets[slot].TryGetValue(target))
+        {
+            Vector2 offset = target->Center() - Vector2(positionX[slot], positionY[slot]);
+
+            if (offset.Dot(offset) >= reachSquared[slot])
+            {
+                targets[slot].Invalidate();
+                continue;
+            }
+
+            fireballTimeout[slot] -= deltaTime;
+            if (fireballTimeout[slot] <= 0)
+            {
+                fireballTimeout[slot] = towers[slot]->FireballTimeoutLength;
+                towers[slot]->ShootFireball(target);
+            }
+        }
+        else if (bodiesInRegion[slot] > 0)
+        {
+            targets[slot].Invalidate();
+
+            Entity* closestEnemy = FindClosestEnemy(slot);
+            if (closestEnemy != nullptr)
+            {
+                targets[slot] = EntityReference<Entity>(closestEnemy);
+            }
+        }
+    }
+}
+
+Entity* TowerSystem::FindClosestEnemy(int slot)
+{
+    PROFILE_ZONE("TowerSystem::FindClosestEnemy");
+
+    Vector2 position(positionX[slot], positionY[slot]);
+    float reach = std::sqrt(reachSquared[slot]);
+    TeamFilter enemies = TeamFilter::EnemiesOf(towers[slot]->team->teamId);
+
+    candidates.clear();
+    candidateX.clear();
+    candidateY.clear();
+
+    auto addCandidate = [&](Entity* entity)
+    {
+        candidates.push_back(entity);
+        candidateX.push_back(entity->Center().x);
+        candidateY.push_back(entity->Center().y);
+    };
+
+    auto spatialHash = scene->GetService<SpatialHashService>();
+    spatialHash->ForEachInRadius<PlayerEntity>(position, reach, enemies, addCandidate);
+    spatialHash->ForEachInRadius<MinionEntity>(position, reach, enemies, addCandidate);
+
+    int count = static_cast<int>(candidates.size());
+    if (count == 0)
+    {
+        return nullptr;
+    }
+
+    // Distances in one branch-free loop over the packed positions, which the compiler vectorizes, then the minimum
+    candidateDistanceSquared.resize(count);
+    const float* xs = candidateX.data();
+    const float* ys = candidateY.data();
+    float* distancesSquared = candidateDistanceSquared.data();
+
+    for (int i = 0; i < count; ++i)
+    {
+        float dx = xs[i] - position.x;
+        float dy = ys[i] - position.y;
+        distancesSquared[i] = dx * dx + dy * dy;
+    }
+
+    int closest = 0;
+    for (int i = 1; i < count; ++i)
+    {
+        if (distancesSquared[i] < distancesSquared[closest])
+        {
+            closest = i;
+        }
+    }
+
+    // Targets are dropped once they're at reach, so one exactly at reach isn't worth picking
+    return distancesSquared[closest] < reachSquared[slot] ? candidates[closest] : nullptr;
+}
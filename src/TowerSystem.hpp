@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "Scene/Scene.hpp"
+
+struct TowerEntity;
+
+// Updates every tower in one pass. Tower state is kept in parallel arrays indexed by slot, and towers are only searched
+// for targets while an enemy is inside their reach, so idle towers cost a compare per step.
+class TowerSystem : public ISceneService
+{
+public:
+    void Add(TowerEntity* tower);
+    void Remove(TowerEntity* tower);
+
+    // Tracks enemies entering and leaving a tower's reach, targets are only searched for while there are any
+    void OnRegionEntered(TowerEntity* tower);
+    void OnRegionExited(TowerEntity* tower);
+
+    // Switches an attacking tower to the given target, as when it's hit
+    void Retarget(TowerEntity* tower, Entity* target);
+
+    // Stepped by the SimulationStepEntity, so fireball cooldowns advance with the fixed timestep
+    void FixedUpdate(float deltaTime);
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+private:
+    Entity* FindClosestEnemy(int slot);
+
+    std::vector<TowerEntity*> towers;
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> reachSquared;
+    std::vector<float> fireballTimeout;
+    std::vector<int> bodiesInRegion;
+    std::vector<EntityReference<Entity>> targets;
+
+    // Candidates for the tower being searched
+    std::vector<Entity*> candidates;
+    std::vector<float> candidateX;
+    std::vector<float> candidateY;
+    std::vector<float> candidateDistanceSquared;
+};
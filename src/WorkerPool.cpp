@@ -0,0 +1,90 @@
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(int threadCount)
+{
+    for (int i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([=] { RunWorker(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+
+    jobStarted.notify_all();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& work)
+{
+    if (threads.empty() || count <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            work(i);
+        }
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        job = &work;
+        jobCount = count;
+        nextItem = 0;
+        workersFinished = 0;
+        ++jobGeneration;
+    }
+
+    jobStarted.notify_all();
+    RunItems();
+
+    // Every worker has to check in, even one that woke too late to get an item, before the job can go out of scope
+    std::unique_lock<std::mutex> lock(mutex);
+    jobFinished.wait(lock, [=] { return workersFinished == static_cast<int>(threads.size()); });
+    job = nullptr;
+}
+
+void WorkerPool::RunWorker()
+{
+    uint64_t lastGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobStarted.wait(lock, [&] { return stopping || jobGeneration != lastGeneration; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            lastGeneration = jobGeneration;
+        }
+
+        RunItems();
+
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            ++workersFinished;
+        }
+
+        jobFinished.notify_one();
+    }
+}
+
+void WorkerPool::RunItems()
+{
+    for (int i = nextItem++; i < jobCount; i = nextItem++)
+    {
+        (*job)(i);
+    }
+}
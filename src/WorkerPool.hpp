@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads for splitting per-entity work within a tick. The calling thread works too, so a pool of N
+// threads runs N + 1 items at once.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    // Runs work(i) for every i in [0, count) and returns once all of them are done
+    void ParallelFor(int count, const std::function<void(int)>& work);
+
+    int ThreadCount() const { return static_cast<int>(threads.size()); }
+
+private:
+    void RunWorker();
+    void RunItems();
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextItem { 0 };
+    uint64_t jobGeneration = 0;
+    int workersFinished = 0;
+    bool stopping = false;
+};
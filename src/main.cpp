@@ -1,4 +1,5 @@
 #include <SDL2/SDL.h>
+#include <cstring>
 
 #include "Engine.hpp"
 #include "InputService.hpp"
@@ -11,6 +12,14 @@
 #include "Scene/Scene.hpp"
 #include "Scene/TilemapEntity.hpp"
 #include "Tools/Console.hpp"
+#include "SkipVisuals.hpp"
+#include "GameMetrics.hpp"
+#include "SpatialHashService.hpp"
+#include "TeamRegistryService.hpp"
+#include "RespawnService.hpp"
+#include "TowerSystem.hpp"
+#include "MinionSystem.hpp"
+#include "FlowFieldService.hpp"
 
 struct Game : IGame
 {
@@ -37,6 +46,12 @@ struct Game : IGame
     void BuildScene(Scene* scene) override
     {
     	auto neuralNetworkManager = GetEngine()->GetNeuralNetworkManager();
+        scene->AddService<TeamRegistryService>();
+        scene->AddService<FlowFieldService>();
+        scene->AddService<SpatialHashService>();
+        scene->AddService<RespawnService>();
+        scene->AddService<TowerSystem>();
+        scene->AddService<MinionSystem>();
     	auto inputService = scene->AddService<InputService>();
         scene->AddService<PlayerNeuralNetworkService>(neuralNetworkManager->GetNetwork<PlayerNetwork>("nn"), inputService);
     }
@@ -49,7 +64,12 @@ struct Game : IGame
         // Create networks
         {
             auto playerDecider = neuralNetworkManager->CreateDecider<PlayerDecider>();
-            auto playerTrainer = neuralNetworkManager->CreateTrainer<PlayerTrainer>(engine->GetMetricsManager()->GetOrCreateMetric("loss"));
+#ifdef SINGLEPLAYER_DECIDER_ONLY
+            // Policies are loaded from nn-frozen-policy and never trained
+            PlayerTrainer* playerTrainer = nullptr;
+#else
+            auto playerTrainer = neuralNetworkManager->CreateTrainer<PlayerTrainer>(engine->GetMetricsManager());
+#endif
 
         	int sequenceLength = 1;
             neuralNetworkManager->CreateNetwork("nn", playerDecider, playerTrainer, sequenceLength);
@@ -58,28 +78,39 @@ struct Game : IGame
         // Add types of objects the sensors can pick up
         {
             SensorObjectDefinition sensorDefinition;
-            sensorDefinition.Add<PlayerEntity>(1).SetColor(Color::Red()).SetPriority(1);
-            sensorDefinition.Add<TilemapEntity>(2).SetColor(Color::Gray()).SetPriority(0);
-            sensorDefinition.Add<CastleEntity>(3).SetColor(Color::Blue()).SetPriority(0.7);
-            sensorDefinition.Add<TowerEntity>(4).SetColor(Color::Orange()).SetPriority(0.9);
-            sensorDefinition.Add<MinionEntity>(5).SetColor(Color::Green()).SetPriority(0.8);
+            sensorDefinition.Add<PlayerEntity>(1).SetColor(Color::Red()).SetPriority(SensorPriority::Player);
+            sensorDefinition.Add<TilemapEntity>(2).SetColor(Color::Gray()).SetPriority(SensorPriority::Tilemap);
+            sensorDefinition.Add<CastleEntity>(3).SetColor(Color::Blue()).SetPriority(SensorPriority::Castle);
+            sensorDefinition.Add<TowerEntity>(4).SetColor(Color::Orange()).SetPriority(SensorPriority::Tower);
+            sensorDefinition.Add<MinionEntity>(5).SetColor(Color::Green()).SetPriority(SensorPriority::Minion);
 
             neuralNetworkManager->SetSensorObjectDefinition(sensorDefinition);
         }
 
+        metricsExporter = std::make_unique<MetricsExporter>(engine->GetMetricsManager());
+
         engine->StartSinglePlayerGame("erebor");
     }
 
     std::string initialConsoleCmd;
+    std::unique_ptr<MetricsExporter> metricsExporter;
 };
 
 int main(int argc, char* argv[])
 {
     Game game;
 
-    if (argc >= 2)
+    // Usage: SingleplayerDemo [--no-visuals] [initial console command]
+    for (int i = 1; i < argc; ++i)
     {
-        game.initialConsoleCmd = argv[1];
+        if (strcmp(argv[i], "--no-visuals") == 0)
+        {
+            g_skipVisuals = true;
+        }
+        else
+        {
+            game.initialConsoleCmd = argv[i];
+        }
     }
 
     game.Run();